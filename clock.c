@@ -0,0 +1,305 @@
+#include "clock.h"
+#include "rtc.h"
+#include "syscalls.h"
+#include "schedule.h"
+#include "waitqueue.h"
+#include "timer.h"
+
+/*tsc at boot and its rate; tsc_mult is 0 when the tsc can't be used*/
+static uint64_t tsc_boot;
+static uint32_t tsc_khz;
+static uint32_t tsc_mult;
+
+/*without a tsc, time only moves by whole PIT ticks*/
+static uint64_t tick_clock_ns;
+
+/*seconds since 1970 at the moment tsc_boot was read*/
+static uint32_t boot_epoch;
+
+/*days before the first of each month in a non-leap year*/
+static const uint16_t month_days[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+/*
+rdtsc - reads the time stamp counter
+input: none
+output: cycles since the cpu was reset
+effect: none
+*/
+static inline uint64_t rdtsc(){
+	uint32_t lo, hi;
+	asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+div64_32 - divides a 64 bit number by a 32 bit one without libgcc
+input: n - the dividend, replaced by the quotient, base - the divisor
+output: the remainder
+effect: two divl steps, the first one on the high half
+*/
+uint32_t div64_32(uint64_t* n, uint32_t base){
+	uint32_t high = (uint32_t)(*n >> 32);
+	uint32_t low = (uint32_t)*n;
+	uint32_t q_high = 0;
+	uint32_t rem;
+
+	if(high >= base){
+		q_high = high / base;
+		high %= base;
+	}
+	asm ("divl %4"
+		: "=a"(low), "=d"(rem)
+		: "0"(low), "1"(high), "rm"(base));
+	*n = ((uint64_t)q_high << 32) | low;
+	return rem;
+}
+
+/*
+tsc_calibrate - measures the tsc rate against PIT channel 2
+input: none
+output: none
+effect: sets tsc_khz and tsc_mult, or leaves tsc_mult 0 if the cpu has no tsc
+		or channel 2 never counts down
+*/
+static void tsc_calibrate(){
+	uint32_t eax, ebx, ecx, edx;
+	uint32_t count = PIT_INPUT_HZ * CALIBRATE_MS / 1000;
+	uint32_t spins;
+	uint64_t t0, t1, mult;
+	uint8_t gate;
+
+	asm volatile ("cpuid"
+				: "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+				: "a"(1));
+	if(!(edx & CPUID_TSC))
+		return;
+
+	gate = inb(PIT_GATE_PORT);
+	outb((gate & ~PIT_GATE_SPEAKER) | PIT_GATE_ENABLE, PIT_GATE_PORT);
+	outb(PIT_CH2_ONESHOT, PIT_CMD_PORT);
+	outb(count & 0xff, PIT_CH2_PORT);
+	outb((count >> 8) & 0xff, PIT_CH2_PORT);	//counting starts here
+	t0 = rdtsc();
+	for(spins = 0; spins < CALIBRATE_SPINS; spins++){
+		if(inb(PIT_GATE_PORT) & PIT_GATE_OUT)
+			break;
+	}
+	t1 = rdtsc();
+	outb(gate, PIT_GATE_PORT);
+	if(spins == CALIBRATE_SPINS)
+		return;
+
+	tsc_khz = (uint32_t)(t1 - t0) / CALIBRATE_MS;
+	if(tsc_khz < TSC_KHZ_MIN)
+		return;
+	mult = (uint64_t)1000000 << TSC_SHIFT;
+	div64_32(&mult, tsc_khz);
+	tsc_mult = (uint32_t)mult;
+}
+
+/*
+cmos_read - reads one CMOS clock register
+input: reg - the register
+output: its value
+effect: selects the register through the RTC ports with NMI disabled
+*/
+static uint8_t cmos_read(uint8_t reg){
+	outb(DISABLE_NMI + reg, RTC_PORT_1);
+	return inb(RTC_PORT_2);
+}
+
+/*
+bcd_to_bin - converts a packed bcd byte
+input: v - two bcd digits
+output: the binary value
+effect: none
+*/
+static uint32_t bcd_to_bin(uint8_t v){
+	return (v >> 4) * 10 + (v & 0x0f);
+}
+
+/*
+cmos_epoch - reads the wall clock from CMOS
+input: none
+output: seconds since 00:00:00 1 January 1970, taking the CMOS clock as UTC
+effect: reads until two passes agree, so an update in the middle is not seen
+*/
+static uint32_t cmos_epoch(){
+	uint8_t now[6], last[6];
+	uint8_t reg_b;
+	uint32_t sec, min, hour, day, month, year, days, y;
+	int32_t i, same;
+
+	do{
+		while(cmos_read(REGISTER_A) & CMOS_UPDATING);
+		last[0] = cmos_read(CMOS_SECONDS);
+		last[1] = cmos_read(CMOS_MINUTES);
+		last[2] = cmos_read(CMOS_HOURS);
+		last[3] = cmos_read(CMOS_DAY);
+		last[4] = cmos_read(CMOS_MONTH);
+		last[5] = cmos_read(CMOS_YEAR);
+		while(cmos_read(REGISTER_A) & CMOS_UPDATING);
+		now[0] = cmos_read(CMOS_SECONDS);
+		now[1] = cmos_read(CMOS_MINUTES);
+		now[2] = cmos_read(CMOS_HOURS);
+		now[3] = cmos_read(CMOS_DAY);
+		now[4] = cmos_read(CMOS_MONTH);
+		now[5] = cmos_read(CMOS_YEAR);
+		same = 1;
+		for(i = 0; i < 6; i++){
+			if(now[i] != last[i])
+				same = 0;
+		}
+	}while(!same);
+
+	reg_b = cmos_read(REGISTER_B);
+	if(reg_b & CMOS_BINARY){
+		sec = now[0];
+		min = now[1];
+		hour = now[2] & ~CMOS_PM;
+		day = now[3];
+		month = now[4];
+		year = now[5];
+	}
+	else{
+		sec = bcd_to_bin(now[0]);
+		min = bcd_to_bin(now[1]);
+		hour = bcd_to_bin(now[2] & ~CMOS_PM);
+		day = bcd_to_bin(now[3]);
+		month = bcd_to_bin(now[4]);
+		year = bcd_to_bin(now[5]);
+	}
+	if(!(reg_b & CMOS_24HOUR)){
+		hour %= 12;
+		if(now[2] & CMOS_PM)
+			hour += 12;
+	}
+	if(month < 1 || month > 12)
+		month = 1;
+	year += (year < 70) ? 2000 : 1900;
+
+	days = 0;
+	for(y = 1970; y < year; y++)
+		days += ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0) ? 366 : 365;
+	days += month_days[month - 1] + day - 1;
+	if(month > 2 && ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0))
+		days++;
+	return ((days * 24 + hour) * 60 + min) * 60 + sec;
+}
+
+/*
+clock_init - sets up the kernel clocks
+input: none
+output: none
+effect: times the tsc against the PIT, then reads the wall clock once. Called at
+		boot before the PIT starts interrupting
+*/
+void clock_init(){
+	uint32_t flags;
+
+	cli_and_save(flags);
+	tsc_calibrate();
+	boot_epoch = cmos_epoch();
+	tsc_boot = rdtsc();
+	tick_clock_ns = 0;
+	restore_flags(flags);
+
+	if(tsc_mult != 0)
+		printf("tsc: %u khz\n", tsc_khz);
+	else
+		printf("tsc: not usable, timing by PIT ticks\n");
+}
+
+/*
+clock_has_tsc - whether time is kept by the tsc
+input: none
+output: 1 if it is, 0 if time only moves with PIT ticks
+effect: none. Tickless idle needs the tsc to know how long it slept
+*/
+int32_t clock_has_tsc(){
+	return tsc_mult != 0;
+}
+
+/*
+clock_now_ns - monotonic time
+input: none
+output: nanoseconds since clock_init
+effect: the 96 bit product cycles * tsc_mult is taken in two 32 bit halves
+*/
+uint64_t clock_now_ns(){
+	uint64_t cycles;
+	uint64_t ns;
+	uint32_t flags;
+
+	if(tsc_mult == 0){
+		cli_and_save(flags);
+		ns = tick_clock_ns;
+		restore_flags(flags);
+		return ns;
+	}
+	cycles = rdtsc() - tsc_boot;
+	return (((uint64_t)(uint32_t)(cycles >> 32) * tsc_mult) << (32 - TSC_SHIFT))
+		+ (((uint64_t)(uint32_t)cycles * tsc_mult) >> TSC_SHIFT);
+}
+
+/*
+clock_tick - runs once per PIT interrupt
+input: tick_ns - length of a tick
+output: none
+effect: keeps time when there is no tsc
+*/
+void clock_tick(uint32_t tick_ns){
+	tick_clock_ns += tick_ns;
+}
+
+/*
+sleep_timeout - timer callback for a sleeping process
+input: data - the pcb
+output: none
+effect: puts it back on the run queue
+*/
+static void sleep_timeout(uint32_t data){
+	sched_wakeup((pcb*)data);
+}
+
+/*
+clock_sleep_until - sleeps the current process
+input: wake_ns - monotonic time to wake at
+output: none
+effect: the process waits on the timer wheel, off the run queue, until the first
+		PIT tick at or after wake_ns
+*/
+void clock_sleep_until(uint64_t wake_ns){
+	uint32_t flags;
+	uint64_t now;
+
+	cli_and_save(flags);
+	while((now = clock_now_ns()) < wake_ns){
+		sched_nohz_sync();		//timer_jiffies may be behind while tickless
+		timer_setup(&curr_pcb->sleep_timer, sleep_timeout, (uint32_t)curr_pcb);
+		timer_add(&curr_pcb->sleep_timer, timer_jiffies + timer_ns_to_ticks(wake_ns - now));
+		curr_pcb->state = PROC_SLEEPING;
+		wait_block();
+	}
+	restore_flags(flags);
+}
+
+/*
+clock_read - reads a clock
+input: clk_id - CLOCK_REALTIME or CLOCK_MONOTONIC, ts - where to put the time
+output: 0 on success, -1 for an unknown clock
+effect: fills ts
+*/
+int32_t clock_read(uint32_t clk_id, timespec_t* ts){
+	uint64_t ns = clock_now_ns();
+	uint32_t nsec;
+
+	if(clk_id != CLOCK_REALTIME && clk_id != CLOCK_MONOTONIC)
+		return -1;
+	nsec = div64_32(&ns, NS_PER_SEC);
+	ts->tv_sec = (uint32_t)ns;
+	ts->tv_nsec = nsec;
+	if(clk_id == CLOCK_REALTIME)
+		ts->tv_sec += boot_epoch;
+	return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include "types.h"
+#include "lib.h"
+#include "pcb.h"
+
+/*PIT channel 2, used once at boot to time the TSC*/
+#define PIT_CH2_PORT 0x42
+#define PIT_CMD_PORT 0x43
+#define PIT_GATE_PORT 0x61
+#define PIT_GATE_ENABLE 0x01		//gate input of channel 2
+#define PIT_GATE_SPEAKER 0x02		//keep the speaker off
+#define PIT_GATE_OUT 0x20			//output of channel 2
+#define PIT_CH2_ONESHOT 0xB0		//channel 2, lobyte/hibyte, mode 0
+#define PIT_INPUT_HZ 1193180
+#define CALIBRATE_MS 10
+#define CALIBRATE_SPINS 10000000	//give up if channel 2 never fires
+#define CPUID_TSC 0x10				//edx bit 4 of cpuid leaf 1
+
+/*monotonic ns = (cycles * tsc_mult) >> TSC_SHIFT*/
+#define TSC_SHIFT 24
+#define TSC_KHZ_MIN 4000			//slowest tsc the 32 bit multiplier can describe
+
+/*CMOS clock registers, read through the RTC ports*/
+#define CMOS_SECONDS 0x00
+#define CMOS_MINUTES 0x02
+#define CMOS_HOURS 0x04
+#define CMOS_DAY 0x07
+#define CMOS_MONTH 0x08
+#define CMOS_YEAR 0x09
+#define CMOS_UPDATING 0x80			//register a: update in progress
+#define CMOS_BINARY 0x04			//register b: values are binary, not bcd
+#define CMOS_24HOUR 0x02			//register b: hours run 0-23
+#define CMOS_PM 0x80				//hour bit set for pm in 12 hour mode
+
+#define NS_PER_SEC 1000000000
+
+/*clock ids for clock_gettime*/
+#define CLOCK_REALTIME 0
+#define CLOCK_MONOTONIC 1
+
+typedef struct timespec_t{
+	uint32_t tv_sec;
+	uint32_t tv_nsec;
+}timespec_t;
+
+/*times the tsc against the PIT and reads the wall clock from CMOS*/
+extern void clock_init();
+/*1 if clock_now_ns runs off the tsc rather than PIT ticks*/
+extern int32_t clock_has_tsc();
+/*nanoseconds since boot*/
+extern uint64_t clock_now_ns();
+/*called from every PIT interrupt*/
+extern void clock_tick(uint32_t tick_ns);
+/*sleeps the current process until the monotonic clock reaches wake_ns*/
+extern void clock_sleep_until(uint64_t wake_ns);
+/*64 by 32 bit division; n becomes the quotient, returns the remainder*/
+extern uint32_t div64_32(uint64_t* n, uint32_t base);
+/*fills ts with the time of clock clk_id*/
+extern int32_t clock_read(uint32_t clk_id, timespec_t* ts);
+
+#endif
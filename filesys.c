@@ -3,15 +3,146 @@
 #include "pcb.h"
 
 
+/*hashed index of the directory entries, built once at mount*/
+static int8_t dentry_index[DENTRY_HASH_SIZE];		//dentry number stored in each slot, -1 if empty
+static uint32_t dentry_hash[DENTRY_HASH_SIZE];		//full hash of the name in each slot
+
+/*contiguous block runs of each inode, built once at mount*/
+static extent_t extent_pool[EXTENT_POOL_SIZE];
+static uint32_t extent_pool_used;
+static inode_extents_t inode_extents[INODE_MAX];
+
+/*metadata of recently executed programs*/
+static exec_cache_t exec_cache[EXEC_CACHE_SIZE];
+static uint32_t exec_clock;
+static exec_stats_t exec_counters;
+
+
 /*
 filesys_init - initializes the filesystem
 Input: address of filesystem
 Output: none
-Effect: sets up the filesystem address
+Effect: sets up the filesystem address and builds the hashed dentry index
 */
 void filesys_init(unsigned int addr)
 {
+	uint32_t i, slot, hash, entries_no;
+	bootblock_t* bootblock;
+	dentry_t* curr_dentry;
+
 	FILESYS_START_ADDR = (uint32_t) addr;
+	bootblock = (bootblock_t*)FILESYS_START_ADDR;
+
+	for(i=0; i<DENTRY_HASH_SIZE; i++)
+		dentry_index[i] = DENTRY_HASH_EMPTY;
+
+	entries_no = bootblock->dir_no;
+	if(entries_no > DENTRY_MAX)
+		entries_no = DENTRY_MAX;
+
+	/*insert every entry in directory order, so the first of any duplicate names wins*/
+	for(i=0; i<entries_no; i++)
+	{
+		curr_dentry = ((dentry_t*)bootblock)+i+1;
+		hash = fname_hash(curr_dentry->fname);
+		/*linear probing; the table is never more than half full*/
+		slot = hash & DENTRY_HASH_MASK;
+		while(dentry_index[slot] != DENTRY_HASH_EMPTY)
+			slot = (slot+1) & DENTRY_HASH_MASK;
+		dentry_index[slot] = (int8_t)i;
+		dentry_hash[slot] = hash;
+	}
+
+	/*a new image invalidates every cached executable*/
+	for(i=0; i<EXEC_CACHE_SIZE; i++)
+		exec_cache[i].in_use = 0;
+
+	/*turn each inode's block list into contiguous runs*/
+	extent_pool_used = 0;
+	for(i=0; i<INODE_MAX; i++)
+	{
+		inode_extents[i].cached = 0;
+		if(i < bootblock->inode_no)
+			build_extents(i);
+	}
+}
+
+/*
+build_extents - caches the block runs of an inode
+Input: inode index
+Output: none
+Effect: appends the inode's runs to the extent pool; if the pool is full
+		the inode is left uncached and read_data walks its blocks instead
+*/
+void build_extents(uint32_t inode)
+{
+	uint32_t i, flen, blk_count, data_blk;
+	uint32_t* curr_inode;
+	bootblock_t* bootblock;
+	inode_extents_t* ext;
+	extent_t* run;
+
+	bootblock = (bootblock_t*)FILESYS_START_ADDR;
+	curr_inode = (uint32_t*)(FILESYS_START_ADDR + (inode+1)*BLOCK_SIZE);
+	ext = &inode_extents[inode];
+
+	flen = curr_inode[0];
+	blk_count = (flen + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if(blk_count > INODE_BLK_MAX)
+		blk_count = INODE_BLK_MAX;
+
+	ext->first = extent_pool_used;
+	ext->count = 0;
+	ext->valid_blks = 0;
+	run = NULL;
+
+	for(i=0; i<blk_count; i++)
+	{
+		data_blk = curr_inode[i+1];
+		/*a bad block number ends the runs; reads that reach it fail*/
+		if(data_blk >= bootblock->datablk_no)
+			break;
+		/*extend the current run if this block follows the previous one*/
+		if(run != NULL && run->data_blk + run->blk_count == data_blk)
+		{
+			run->blk_count++;
+		}
+		else
+		{
+			if(extent_pool_used >= EXTENT_POOL_SIZE)
+			{
+				/*out of runs, roll this inode back to the block walk*/
+				extent_pool_used = ext->first;
+				return;
+			}
+			run = &extent_pool[extent_pool_used++];
+			run->file_blk = i;
+			run->data_blk = data_blk;
+			run->blk_count = 1;
+			ext->count++;
+		}
+		ext->valid_blks++;
+	}
+	ext->cached = 1;
+}
+
+/*
+fname_hash - hashes a file name
+Input: file name, at most FNAME_MAX_CHAR significant characters
+Output: FNV-1a hash of the name
+Effect: none
+*/
+uint32_t fname_hash(const uint8_t* fname)
+{
+	uint32_t i, hash;
+
+	hash = FNV_OFFSET_BASIS;
+	for(i=0; (i<FNAME_MAX_CHAR) && (fname[i] != '\0'); i++)
+	{
+		hash ^= fname[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
 }
 
 
@@ -89,6 +220,58 @@ int32_t directory_read(int32_t fd, void* buf, int32_t nbytes)
 }
 
 
+/*
+directory_getdents - reads as many directory entries as fit in the buffer
+Input: file descriptor of an open directory, buffer of dirent_t records, its size in bytes
+Output: -1 on fail, bytes filled in on success, 0 once every entry has been read
+Effect: fills in the name, type, inode and length of each entry and moves the
+		directory position past them, so a whole listing takes one call
+*/
+int32_t directory_getdents(int32_t fd, dirent_t* buf, int32_t nbytes)
+{
+	uint32_t offset, count;
+	bootblock_t* bootblock;
+	dentry_t* curr_dentry;
+
+	if(nbytes < (int32_t)sizeof(dirent_t))
+		return -1;
+
+	bootblock = (bootblock_t*)FILESYS_START_ADDR;
+	offset = curr_pcb->file_array[fd].file_pos;
+
+	count = 0;
+	while(offset < bootblock->dir_no && (count + 1) * sizeof(dirent_t) <= (uint32_t)nbytes){
+		curr_dentry = ((dentry_t*)bootblock) + offset + 1;
+		memcpy(buf[count].name, curr_dentry->fname, FNAME_MAX_CHAR);
+		buf[count].type = curr_dentry->ftype;
+		buf[count].inode = curr_dentry->finode_type;
+		buf[count].length = 0;
+		if(curr_dentry->ftype == FTYPE_FILE && curr_dentry->finode_type < bootblock->inode_no)
+			buf[count].length = *(uint32_t*)(FILESYS_START_ADDR + (curr_dentry->finode_type+1)*BLOCK_SIZE);
+		count++;
+		offset++;
+	}
+
+	curr_pcb->file_array[fd].file_pos = offset;
+	return count * sizeof(dirent_t);
+}
+
+
+/*
+directory_stat - describes an open directory
+Input: file descriptor, stat_t to fill in
+Output: 0 always
+Effect: the length of a directory is its number of entries
+*/
+int32_t directory_stat(int32_t fd, stat_t* st)
+{
+	st->type = FTYPE_DIR;
+	st->inode = curr_pcb->file_array[fd].inode_ptr;
+	st->length = ((bootblock_t*)FILESYS_START_ADDR)->dir_no;
+	return 0;
+}
+
+
 /*
 Closes a directory
 Inputs: file descriptor
@@ -115,75 +298,40 @@ Side effect: if file exists, fills in dentry passed in as parameter
 */
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry){
 
-	int i, j, char_mismatch;
-	bootblock_t* bootblock;
+	int j;
+	uint32_t slot, hash;
 	dentry_t* curr_dentry;
-	uint8_t curr_char;
 
-	/*indicates if broke out of loop due to different name*/
-	char_mismatch = 0;
-	/*addr of boot block*/
-	bootblock = (bootblock_t*)FILESYS_START_ADDR;
-
-	uint32_t entries_no, inode_no, data_no;
-	entries_no = bootblock->dir_no;
-	inode_no = 	bootblock->inode_no;
-	data_no =  bootblock->datablk_no;
+	/*empty names can never match, skip hashing*/
+	if(fname == NULL || fname[0] == '\0')
+		return -1;
 
-	//printf("%d",entries_no);
+	hash = fname_hash(fname);
+	slot = hash & DENTRY_HASH_MASK;
 
-	/*if there are no dir entries, return failure*/
-	if(entries_no == 0)
+	/*an empty slot ends the probe: the name is not in the directory*/
+	while(dentry_index[slot] != DENTRY_HASH_EMPTY)
 	{
-		//printf("No such file exists.\n");
-		return -1;
-	}
-	
-	for(i=0; i<entries_no; i++){
-
-		/* ptr arithmetic to next dir entry*/
-		curr_dentry =((dentry_t*)bootblock)+i+1;
-		
-		/*check if the filename matches*/
-		for ( j=0; j<FNAME_MAX_CHAR ; j++)
+		/*only compare names when the full hash matches*/
+		if(dentry_hash[slot] == hash)
 		{
-			curr_char = (uint8_t)curr_dentry->fname[j];
-			/*if fnames are not the same break inner loop and move to next entry*/
-			if (curr_char != fname[j]){
-				char_mismatch = 1;
-				break;
+			curr_dentry = ((dentry_t*)FILESYS_START_ADDR)+dentry_index[slot]+1;
+			if(strncmp((int8_t*)fname, (int8_t*)curr_dentry->fname, FNAME_MAX_CHAR) == 0)
+			{
+				/*fill in the dentry into into the given dentry_t*/
+				for ( j=0; j<FNAME_MAX_CHAR ; j++){
+					dentry->fname[j]= curr_dentry->fname[j];
+				}
+				dentry->ftype = curr_dentry->ftype;
+				dentry->finode_type = curr_dentry->finode_type;
+				return 0;
 			}
-			/* if fname is the same, break out of outer loop*/
-			if(fname[j]=='\0' && curr_char== '\0'){
-				break;
-			}
-
-		}
-
-		/*if fname is not the same, move on to next entry*/
-		if ((char_mismatch == 1) && (i != entries_no-1)){
-			char_mismatch = 0;
-			continue;
 		}
-		/*if fname is not the same and this is the last file, file doesn't exist*/
-		else if((char_mismatch == 1) && (i == entries_no-1)){
-			//printf("No such file exists.\n");
-			return -1;
-		}
-		/*fname is a match, move to next for loop*/
-		else{
-			break;
-		}
-
+		slot = (slot+1) & DENTRY_HASH_MASK;
 	}
 
-	/*fill in the dentry into into the given dentry_t*/
-	for ( j=0; j<FNAME_MAX_CHAR ; j++){
-		dentry->fname[j]= curr_dentry->fname[j];
-	}
-	dentry->ftype = curr_dentry->ftype;
-	dentry->finode_type = curr_dentry->finode_type;
-	return 0;
+	//printf("No such file exists.\n");
+	return -1;
 }
 
 /*
@@ -234,87 +382,77 @@ Side effect: if file exists, fills in buffer with the relevant data
 */
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length)
 {
-	uint8_t* curr_inode = NULL;
-	uint8_t curr_char;
-	uint32_t blk_offset, data_offset, datablk_no, flen, data_copied, curr_offset;
-	int j,k;
-
-	k=0;
-	data_copied=0;
-
+	uint32_t* curr_inode;
+	uint8_t* data_base;
+	uint32_t flen, blk, blk_offset, datablk_no, chunk, data_copied, run_left;
+	uint32_t i;
 	bootblock_t* bootblock;
-	bootblock = (bootblock_t*)FILESYS_START_ADDR;
-	curr_inode = (uint8_t*)FILESYS_START_ADDR;
+	inode_extents_t* ext;
+	extent_t* run;
 
-	uint32_t entries_no, inode_no, data_no;
-	entries_no = bootblock->dir_no;
-	inode_no = 	bootblock->inode_no;
-	data_no =  bootblock->datablk_no;
+	bootblock = (bootblock_t*)FILESYS_START_ADDR;
 
 	/*check if inode number is in the valid range. 
-	  if it is not, file has been completely read.[*/
+	  if it is not, file has been completely read.*/
 	if (length == 0)
 		return 0;
 
-	if (inode > inode_no)
+	if (inode >= bootblock->inode_no)
 		return 0;
 
-	curr_offset = offset;
-	/*ptr to the start of the given inode*/
-	curr_inode = curr_inode+(inode+1)*BLOCK_SIZE;
-	/*data block to start reading from*/
-	blk_offset = offset / BLOCK_SIZE;
-	/*byte in the data block to start reading from*/
-	data_offset = offset % BLOCK_SIZE;
-	/* data block # to start reading from*/
-	datablk_no = *(int32_t*)(curr_inode + (blk_offset+1)*ENTRY_FIELD_SIZE);
-	//printf("%d \n",datablk_no );
+	/*ptr to the start of the given inode and of the data blocks*/
+	curr_inode = (uint32_t*)(FILESYS_START_ADDR + (inode+1)*BLOCK_SIZE);
+	data_base = (uint8_t*)(FILESYS_START_ADDR + (bootblock->inode_no+1)*BLOCK_SIZE);
+
 	/*file length*/
-	flen = *(uint32_t*)curr_inode;
-	//printf("%d\n", flen);
+	flen = curr_inode[0];
+	if(offset >= flen)
+		return 0;
 
-	if(curr_offset == flen)
-			return 0;
-							
-	/*check if data block number is valid*/
-	if (datablk_no >= data_no)
-		return -1;
+	/*never copy past the end of the file*/
+	if(length > flen - offset)
+		length = flen - offset;
+
+	ext = NULL;
+	if(inode < INODE_MAX && inode_extents[inode].cached)
+		ext = &inode_extents[inode];
+
+	data_copied = 0;
+	while(data_copied < length){
+		/*data block and byte within it to copy from*/
+		blk = offset / BLOCK_SIZE;
+		blk_offset = offset % BLOCK_SIZE;
+
+		if(ext != NULL){
+			/*a block past the cached runs had a bad block number*/
+			if(blk >= ext->valid_blks)
+				return -1;
+			/*find the run that holds this block*/
+			run = &extent_pool[ext->first];
+			for(i=0; i<ext->count; i++, run++){
+				if(blk < run->file_blk + run->blk_count)
+					break;
+			}
+			/*copy up to the end of the run in one go*/
+			datablk_no = run->data_blk + (blk - run->file_blk);
+			run_left = (run->file_blk + run->blk_count - blk)*BLOCK_SIZE - blk_offset;
+		}
+		else{
+			/*uncached inode: copy up to the end of the block*/
+			datablk_no = curr_inode[blk+1];
+			if (datablk_no >= bootblock->datablk_no)
+				return -1;
+			run_left = BLOCK_SIZE - blk_offset;
+		}
 
-	/*ptr to the start of the datablk to read from*/
-		uint8_t* curr_datablk = NULL;
-		curr_datablk = (uint8_t *) FILESYS_START_ADDR;
-		curr_datablk = curr_datablk + (inode_no)*BLOCK_SIZE+ (datablk_no+1)*BLOCK_SIZE;
-		while(data_copied < length){
-					/*copy data from data block into the buf*/
-					for(j=data_offset; j<BLOCK_SIZE; j++){
-						curr_char = *(uint8_t*)((uint8_t*)curr_datablk+j);
-						//printf("%c",curr_char);
-						buf[k]=curr_char;
-						k++;
-						data_copied++;
-						curr_offset++;
-	
-						if (data_copied==length && curr_offset <= flen)
-							return data_copied;
-						if(curr_offset == flen)
-						{
-							//printf("End of file reached, bytes copied: %d \n", data_copied);
-							return data_copied;
-						}				
-					}
-					/*end of data block is reached, move on to the next data block*/
-					data_offset = 0;
-					blk_offset++;
-					datablk_no = *(int32_t*)(curr_inode + (blk_offset+1)*ENTRY_FIELD_SIZE);
-					curr_datablk = (uint8_t*)FILESYS_START_ADDR;
-					curr_datablk = curr_datablk + inode_no*BLOCK_SIZE+ (datablk_no+1)*BLOCK_SIZE;
-	
-					/*check if data block # is valid*/
-					if(datablk_no >= data_no){
-						return -1;
-					}
-		}	
-	return 0;
+		chunk = length - data_copied;
+		if(chunk > run_left)
+			chunk = run_left;
+		memcpy(buf + data_copied, data_base + datablk_no*BLOCK_SIZE + blk_offset, chunk);
+		data_copied += chunk;
+		offset += chunk;
+	}
+	return data_copied;
 }
 
 /*
@@ -387,73 +525,337 @@ Effects: None
 }
 
 /*
-Copies a program image from file system to 128MB virtual memory
-Input: Empty Dentry, Filename
-Output: -1 on failure. 0 on success.
-Effects: Loads the image into our memory
-*/ 
-int32_t program_load (const uint8_t* fname, dentry_t* dentry)
-{	
-	uint32_t i,j;										
-	uint32_t *total_inodes_count, *data_block_base, *inode_base;
-	uint32_t end_of_file_flag, program_size_byte, data_block_count;
-	
-	total_inodes_count 	= (uint32_t*)(FILESYS_START_ADDR + 4);													    	//	total number of inode in file system used to calculate data block address
-	data_block_base 	= (uint32_t*)(FILESYS_START_ADDR + ((uint32_t)(*total_inodes_count)+1) * SIZE_4KB_IN_BYTE);		//	starting address of data block 
-	inode_base 			= (uint32_t*)(FILESYS_START_ADDR + (dentry->finode_type + 1) * SIZE_4MB_IN_KB);					//  program's inode base address
-	program_size_byte 	= *inode_base;																					//  program's size in byte
-
+Moves the read position of a file
+Inputs: fd, offset in bytes, whence - SEEK_SET, SEEK_CUR or SEEK_END
+Outputs: -1 on failure, the new position on success
+Effects: the next read starts at the new position; seeking past the end is
+		 allowed and reads there return 0
+*/
+int32_t file_seek(int32_t fd, int32_t offset, int32_t whence)
+{
+	int32_t base, pos;
+	uint32_t inode;
 
-	
-	if (program_size_byte % SIZE_4KB_IN_BYTE == 0)								// Calculating number of data blocks to copy
-		data_block_count = program_size_byte / SIZE_4KB_IN_BYTE;				// 1 data block contain 4KB (4096 byte)
+	inode = curr_pcb->file_array[fd].inode_ptr;
+	if(whence == SEEK_SET)
+		base = 0;
+	else if(whence == SEEK_CUR)
+		base = curr_pcb->file_array[fd].file_pos;
+	else if(whence == SEEK_END)
+		base = *(uint32_t*)(FILESYS_START_ADDR + (inode+1)*BLOCK_SIZE);
 	else
-		data_block_count = (program_size_byte / SIZE_4KB_IN_BYTE) + 1;
-
-	// TEST BLOCK
-	/*
-	uint32_t *for_test_only = (uint32_t*) FILESYS_START_ADDR;
-	printf("TEST: Filesystem Start: 0x%x                                \n", FILESYS_START_ADDR);
-	printf("TEST: Total Directory entries: %d                           \n", *for_test_only);
-	printf("TEST: Total Inodes addr: 0x%x                               \n", total_inodes_count);
-	printf("TEST: Total Inodes: %d                                      \n", *total_inodes_count);
-	printf("TEST: Data Block Base ADDR: 0x%x                            \n", data_block_base);
-	printf("TEST: Inode_base: 0x%x                                      \n", inode_base);
-	printf("TEST: Program Size in Byte: %d                              \n", program_size_byte);
-	printf("TEST: Data Block Count: %d                             		\n", data_block_count);
-		
-	for (i = 0; i < data_block_count; i++)
+		return -1;
+
+	pos = base + offset;
+	/*negative results and overflow are both errors*/
+	if(pos < 0 || (offset > 0 && pos < base))
+		return -1;
+	curr_pcb->file_array[fd].file_pos = pos;
+	return pos;
+}
+
+/*
+Reads a file at a given position
+Inputs: fd, buffer, bytes to read, offset in bytes to read from
+Outputs: -1 on failure, 0 at end of file, bytes read otherwise
+Effects: the file position is left unchanged
+*/
+int32_t file_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset)
+{
+	if(curr_pcb->file_array[fd].no_file == 0)
+		return -1;
+	if(nbytes==0)
+		return 0;
+	return read_data(curr_pcb->file_array[fd].inode_ptr, offset, (uint8_t*)buf, nbytes);
+}
+
+/*
+Describes an open file
+Inputs: fd, stat_t to fill in
+Outputs: 0 always
+Effects: reports the file's type, inode and length in bytes
+*/
+int32_t file_stat(int32_t fd, stat_t* st)
+{
+	uint32_t inode;
+	inode = curr_pcb->file_array[fd].inode_ptr;
+	st->type = FTYPE_FILE;
+	st->inode = inode;
+	st->length = *(uint32_t*)(FILESYS_START_ADDR + (inode+1)*BLOCK_SIZE);
+	return 0;
+}
+
+/*
+Maps a file's data blocks read-only into the current process
+Inputs: inode of the file, start - where to store the address of the mapping
+Outputs: -1 on failure, length of the file on success
+Effects: each data block of the file gets its own page in the process's mmap window,
+		 pointing straight into the filesystem image. The tail of the last page past
+		 the end of the file shows the rest of that data block. The mapping lasts
+		 until the process halts
+*/
+int32_t file_mmap(uint32_t inode, uint8_t** start)
+{
+	bootblock_t* bootblock;
+	uint32_t* curr_inode;
+	uint32_t flen, nblks, i, datablk_no, data_base;
+	int32_t vaddr;
+
+	bootblock = (bootblock_t*)FILESYS_START_ADDR;
+	if (curr_pcb == NULL || inode >= bootblock->inode_no)
+		return -1;
+	/*blocks can only be mapped in place if the image is page aligned*/
+	if (FILESYS_START_ADDR & ~PAGE_ADDR_MASK)
+		return -1;
+
+	curr_inode = (uint32_t*)(FILESYS_START_ADDR + (inode+1)*BLOCK_SIZE);
+	data_base = FILESYS_START_ADDR + (bootblock->inode_no+1)*BLOCK_SIZE;
+	flen = curr_inode[0];
+	nblks = (flen + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+	for (i = 0; i < nblks; i++)
 	{
-		uint32_t block_number = inode_base[i+1];
-		printf("Data block Number %d: %d \n", i+1, block_number);
+		if (curr_inode[i+1] >= bootblock->datablk_no)
+			return -1;
+	}
+
+	vaddr = mmap_reserve(curr_pcb->pid, nblks);
+	if (vaddr == -1)
+		return -1;
+	for (i = 0; i < nblks; i++)
+	{
+		datablk_no = curr_inode[i+1];
+		map_file_page(curr_pcb->pid, vaddr + i*BLOCK_SIZE, data_base + datablk_no*BLOCK_SIZE);
 	}
-	*/
-	
-	
-	// Alligns the file image from filesystem to virtual memory starting in (128MB + 0x48000)
 
-	end_of_file_flag = 0;
-	for(i = 0; i < data_block_count; i++)
+	*start = (uint8_t*)vaddr;
+	return flen;
+}
+
+/*
+Finds the layout of a program image
+Input: inode of the image, its cache entry with img_size filled in
+Output: none
+Effects: sets text_end, a multiple of the page size, to the read-only prefix of the
+		 image, and brk_start to the first page past the image and every PT_LOAD
+		 segment's bss. Only a non-writable PT_LOAD segment that sits at its file
+		 offset from the image base can be shared, since the image is mapped file-flat
+*/
+void program_layout (uint32_t inode, exec_cache_t* exe)
+{
+	uint8_t ehdr[ELF_HEADER_SIZE];
+	elf_phdr_t phdr;
+	uint32_t i, phoff, phentsize, phnum, text_end, mem_end, seg_end;
+
+	exe->text_end = 0;
+	mem_end = PROGRAM_IMG_BASE + exe->img_size;
+	exe->brk_start = (mem_end + SIZE_4KB_IN_BYTE - 1) & PAGE_ADDR_MASK;
+	if (read_data(inode, 0, ehdr, ELF_HEADER_SIZE) != ELF_HEADER_SIZE)
+		return;
+	phoff 		= *(uint32_t*)(ehdr + ELF_PHOFF_OFF);
+	phentsize 	= *(uint16_t*)(ehdr + ELF_PHENTSIZE_OFF);
+	phnum 		= *(uint16_t*)(ehdr + ELF_PHNUM_OFF);
+	if (phentsize < ELF_PHDR_SIZE || phnum > ELF_PHNUM_MAX)
+		return;
+
+	text_end = 0;
+	for (i = 0; i < phnum; i++)
 	{
-		uint8_t *block_base, *temp_img_base;
-		uint32_t data_block_number;
-		
-		data_block_number = inode_base[i+1]; 
-		block_base = (uint8_t*)((uint32_t)data_block_base + data_block_number * SIZE_4MB_IN_KB);
-		//TEST:: printf("TEST: Loop Block Base: 0x%x \n", block_base);
-		temp_img_base  = (uint8_t*)(PROGRAM_IMG_BASE + (SIZE_4KB_IN_BYTE * i));
-		//TEST:: printf("TEST: Loop Img Base: 0x%x \n", temp_img_base);
-		
-		for (j = 0; j < SIZE_4KB_IN_BYTE; j++)
+		if (read_data(inode, phoff + i * phentsize, (uint8_t*)&phdr, ELF_PHDR_SIZE) != ELF_PHDR_SIZE)
+			return;
+		if (phdr.p_type != PT_LOAD)
+			continue;
+		// bss past the end of the file must not be handed out as heap. A segment
+		// that reaches past USER_HEAP_END leaves no room for one, and exec_lookup
+		// refuses the image
+		seg_end = phdr.p_vaddr + phdr.p_memsz;
+		if (seg_end < phdr.p_vaddr || seg_end > USER_HEAP_END)
+			seg_end = USER_VMEM_END;
+		if (phdr.p_vaddr >= PROGRAM_IMG_BASE && seg_end > mem_end)
+			mem_end = seg_end;
+		if (phdr.p_flags & PF_W)
+			continue;
+		if (phdr.p_offset != 0 || phdr.p_vaddr != PROGRAM_IMG_BASE)
+			continue;
+		text_end = phdr.p_filesz;
+	}
+
+	if (text_end > exe->img_size)
+		text_end = exe->img_size;
+	// a page that also holds writable data stays private
+	exe->text_end = text_end & PAGE_ADDR_MASK;
+	exe->brk_start = (mem_end + SIZE_4KB_IN_BYTE - 1) & PAGE_ADDR_MASK;
+}
+
+/*
+Looks up the metadata of an executable
+Input: inode of the file
+Output: the cache entry, NULL if the file is not a valid executable
+Effects: on a miss, checks the ELF magic and reads the entry point and text size,
+		 replacing the least recently used entry. Images that would reach into the
+		 stack area are refused. Hits skip all file system reads
+*/
+exec_cache_t* exec_lookup (uint32_t inode)
+{
+	uint8_t ehdr[ELF_HEADER_SIZE];
+	uint32_t i, size;
+	exec_cache_t* exe;
+	exec_cache_t* victim;
+	bootblock_t* bootblock;
+
+	bootblock = (bootblock_t*)FILESYS_START_ADDR;
+	exec_clock++;
+
+	victim = &exec_cache[0];
+	for (i = 0; i < EXEC_CACHE_SIZE; i++)
+	{
+		exe = &exec_cache[i];
+		if (exe->in_use && exe->inode == inode)
 		{
-			*temp_img_base = block_base[j];
-			if( (++end_of_file_flag) >= program_size_byte)
-				break;
-			temp_img_base = temp_img_base +1;
+			exec_counters.hits++;
+			exe->last_use = exec_clock;
+			return exe->valid ? exe : NULL;
 		}
-		// TEST:: printf("TEST: Loop END ADDR: 0x%x \n", temp_img_base);
+		if (!exe->in_use || (victim->in_use && exe->last_use < victim->last_use))
+			victim = exe;
 	}
-	// TEST :: printf("EOF: %d \n", end_of_file_flag);
+
+	exec_counters.misses++;
+	exe = victim;
+	exe->inode = inode;
+	exe->in_use = 1;
+	exe->valid = 0;
+	exe->last_use = exec_clock;
+
+	if (inode >= bootblock->inode_no)
+		return NULL;
+	size = *(uint32_t*)(FILESYS_START_ADDR + (inode + 1) * SIZE_4KB_IN_BYTE);
+	if (read_data(inode, 0, ehdr, ELF_HEADER_SIZE) != ELF_HEADER_SIZE)
+		return NULL;
+
+	/*checks for exe magic numbers*/
+	if (!(ehdr[0] == ELF_MAGIC_0 && ehdr[1] == ELF_MAGIC_1 && ehdr[2] == ELF_MAGIC_2 && ehdr[3] == ELF_MAGIC_3))
+		return NULL;
+
+	/*entry point is stored as little endian in bytes 24-27*/
+	exe->entry_point = *(uint32_t*)(ehdr + ELF_ENTRY_OFF);
+	exe->img_size = size;
+	if (size > USER_HEAP_END - PROGRAM_IMG_BASE)
+		return NULL;
+	program_layout(inode, exe);
+	/*the image and its bss must leave the heap room to start below the stack area*/
+	if (exe->brk_start > USER_HEAP_END)
+		return NULL;
+	exe->valid = 1;
+	return exe;
+}
+
+/*
+Copies out the exec cache counters
+Input: buffer for the counters
+Output: none
+Effects: none
+*/
+void exec_get_stats (exec_stats_t* stats)
+{
+	stats->hits = exec_counters.hits;
+	stats->misses = exec_counters.misses;
+	stats->execs = exec_counters.execs;
+	stats->exec_ns_max = exec_counters.exec_ns_max;
+	stats->exec_ns_total = exec_counters.exec_ns_total;
+}
+
+/*
+Records the latency of one exec
+Input: nanoseconds execute took to set up the program
+Output: none
+Effects: none
+*/
+void exec_account (uint32_t ns)
+{
+	exec_counters.execs++;
+	exec_counters.exec_ns_total += ns;
+	if(ns > exec_counters.exec_ns_max)
+		exec_counters.exec_ns_max = ns;
+}
+
+/*
+Sets up a program image for loading on demand
+Input: cached metadata of the executable
+Output: -1 on failure. 0 on success.
+Effects: records the image in the current pcb; nothing is copied until the
+		 program touches a page, see program_load_page
+*/ 
+int32_t program_load (const exec_cache_t* exe)
+{	
+	if (curr_pcb == NULL || exe == NULL)
+		return -1;
+
+	curr_pcb->img_inode		= exe->inode;
+	curr_pcb->img_size		= exe->img_size;
+	curr_pcb->img_text_end	= exe->text_end;
+	curr_pcb->brk_start		= exe->brk_start;
+	curr_pcb->brk			= exe->brk_start;
 	return 0;
 }
 
+/*
+Maps and fills one page of the current program's window
+Input: faulting virtual address
+Output: -1 on failure. 0 on success.
+Effects: read-only text pages are mapped from the shared pool and only read from the
+		 file system by the first process to touch them. Other pages get a private
+		 frame, zeroed, with the part of the image that falls in it copied in;
+		 pages past the end of the image (bss, heap, stack) stay zero. Pages between
+		 the program break and the stack area are not the program's and fail
+*/
+int32_t program_load_page (uint32_t vaddr)
+{
+	uint32_t page, img_end, flags;
+	uint8_t* frame;
+	int32_t fresh, ret;
+
+	if (curr_pcb == NULL)
+		return -1;
+
+	page = vaddr & PAGE_ADDR_MASK;
+	img_end = PROGRAM_IMG_BASE + curr_pcb->img_size;
+	if (page >= ((curr_pcb->brk + SIZE_4KB_IN_BYTE - 1) & PAGE_ADDR_MASK) && page < USER_HEAP_END)
+		return -1;
+
+	// a shared frame is visible to other processes as soon as map_shared_page
+	// hashes it, so no other process may run until it is filled
+	cli_and_save(flags);
+
+	// the image starts on a page boundary (128MB + 0x48000), so a page is either
+	// wholly before it or starts at file offset (page - PROGRAM_IMG_BASE)
+	fresh = -1;
+	if (page >= PROGRAM_IMG_BASE && page < PROGRAM_IMG_BASE + curr_pcb->img_text_end)
+	{
+		fresh = map_shared_page(curr_pcb->pid, page, curr_pcb->img_inode,
+								(page - PROGRAM_IMG_BASE) / SIZE_4KB_IN_BYTE);
+		if (fresh == 0)
+		{
+			restore_flags(flags);
+			return 0;
+		}
+	}
+	// shared pool exhausted: fall back to a private copy
+	if (fresh == -1 && map_user_page(curr_pcb->pid, page) == -1)
+	{
+		restore_flags(flags);
+		return -1;
+	}
+
+	// fill through the kernel's mapping of the frame, since shared text is read-only
+	ret = 0;
+	frame = (uint8_t*)user_page_frame(curr_pcb->pid, page);
+	memset(frame, 0, SIZE_4KB_IN_BYTE);
+	if (page >= PROGRAM_IMG_BASE && page < img_end)
+	{
+		if (read_data(curr_pcb->img_inode, page - PROGRAM_IMG_BASE, frame, SIZE_4KB_IN_BYTE) == -1)
+			ret = -1;
+	}
+	restore_flags(flags);
+	return ret;
+}
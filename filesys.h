@@ -5,6 +5,7 @@
 #include "types.h"
 #include "x86_desc.h"
 #include "paging.h"
+#include "pcb.h"
 
 /*adress of boot block*/
 uint32_t FILESYS_START_ADDR;
@@ -23,12 +24,84 @@ void print_everything();
 /*offset in the number of bytes for each dir entry*/
 #define FILE_TYPE_OFF 		32
 #define FILE_INODE_NO_OFF 	36
+
+/*boot block holds 64 entries, the first of which is the fs statistics*/
+#define DENTRY_MAX			63
+/*hash index of the dentries; power of two, at least twice DENTRY_MAX*/
+#define DENTRY_HASH_SIZE	128
+#define DENTRY_HASH_MASK	(DENTRY_HASH_SIZE - 1)
+#define DENTRY_HASH_EMPTY	-1
+/*FNV-1a constants for hashing file names*/
+#define FNV_OFFSET_BASIS	2166136261U
+#define FNV_PRIME			16777619U
 #define SIZE_4MB_IN_KB 		4096
 #define SIZE_4MB_IN_BYTE	(4096 * 1024)
 #define SIZE_4KB_IN_BYTE 	4096
 #define PDE_INDEX_128MB 	32
 #define PROGRAM_IMG_BASE 	0x08048000
 
+/*ELF header and program header fields used by the loader*/
+#define ELF_HEADER_SIZE		52
+#define ELF_ENTRY_OFF		24
+#define ELF_PHOFF_OFF		28
+#define ELF_PHENTSIZE_OFF	42
+#define ELF_PHNUM_OFF		44
+#define ELF_PHDR_SIZE		32
+#define ELF_PHNUM_MAX		16
+#define PT_LOAD				1
+#define PF_W				0x2
+
+/*executables whose metadata is kept for repeated execs*/
+#define EXEC_CACHE_SIZE		8
+#define ELF_MAGIC_0			0x7f
+#define ELF_MAGIC_1			0x45
+#define ELF_MAGIC_2			0x4c
+#define ELF_MAGIC_3			0x46
+
+/*validated metadata of one executable*/
+typedef struct exec_cache_t{
+	uint32_t inode;
+	/*1 if the slot holds an entry*/
+	uint32_t in_use;
+	/*1 if the file is a valid executable; failed checks are cached too*/
+	uint32_t valid;
+	uint32_t entry_point;
+	uint32_t img_size;
+	/*read-only prefix of the image, see program_layout*/
+	uint32_t text_end;
+	/*first page past the image and its bss, where the heap starts*/
+	uint32_t brk_start;
+	/*exec count when the entry was last used, for replacement*/
+	uint32_t last_use;
+} exec_cache_t;
+
+/*exec cache counters, returned by the exec_stats system call*/
+typedef struct exec_stats_t{
+	uint32_t hits;
+	uint32_t misses;
+	/*time execute takes from entry to the jump into the new program*/
+	uint32_t execs;
+	uint32_t exec_ns_max;
+	uint64_t exec_ns_total;
+} exec_stats_t;
+
+/*an ELF program header*/
+typedef struct elf_phdr_t{
+	uint32_t p_type;
+	uint32_t p_offset;
+	uint32_t p_vaddr;
+	uint32_t p_paddr;
+	uint32_t p_filesz;
+	uint32_t p_memsz;
+	uint32_t p_flags;
+	uint32_t p_align;
+} elf_phdr_t;
+
+/*block runs of the first INODE_MAX inodes are cached at mount*/
+#define INODE_MAX			64
+#define EXTENT_POOL_SIZE	1024
+#define INODE_BLK_MAX		((BLOCK_SIZE / ENTRY_FIELD_SIZE) - 1)
+
 /*A file descriptor entry*/
 typedef struct bootblock_t{
 	uint32_t dir_no;
@@ -36,24 +109,74 @@ typedef struct bootblock_t{
 	uint32_t datablk_no;
 } bootblock_t;
 
+/*file types of directory entries*/
+#define FTYPE_RTC		0
+#define FTYPE_DIR		1
+#define FTYPE_FILE		2
+
+/*one record returned by getdents*/
+typedef struct dirent_t{
+	uint8_t name[FNAME_MAX_CHAR];
+	uint32_t type;
+	uint32_t inode;
+	/*size in bytes, 0 for anything but a regular file*/
+	uint32_t length;
+} dirent_t;
+
+/*a run of contiguous data blocks in a file*/
+typedef struct extent_t{
+	/*index of the run's first block within the file*/
+	uint32_t file_blk;
+	/*data block number of the run's first block*/
+	uint32_t data_blk;
+	/*number of blocks in the run*/
+	uint32_t blk_count;
+} extent_t;
+
+/*the cached runs of one inode*/
+typedef struct inode_extents_t{
+	/*index of the first run in the extent pool*/
+	uint32_t first;
+	/*number of runs*/
+	uint32_t count;
+	/*blocks covered by the runs; a bad block number ends them early*/
+	uint32_t valid_blks;
+	/*1 if the runs were built, 0 if the inode uses the block walk*/
+	uint32_t cached;
+} inode_extents_t;
+
 extern void filesys_init(unsigned int addr);
-extern int32_t program_load (const uint8_t* fname, dentry_t* dentry);
+extern int32_t program_load (const exec_cache_t* exe);
+extern int32_t program_load_page (uint32_t vaddr);
+void program_layout (uint32_t inode, exec_cache_t* exe);
+extern exec_cache_t* exec_lookup (uint32_t inode);
+extern void exec_get_stats (exec_stats_t* stats);
+/*adds one successful exec to the latency counters*/
+extern void exec_account (uint32_t ns);
 
 /*directory f_ops*/
 extern int32_t directory_open(const uint8_t* filename);
 extern int32_t directory_read(int32_t fd, void* buf, int32_t nbytes);
 extern int32_t directory_close(int32_t fd);
 extern int32_t directory_write(int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t directory_getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+extern int32_t directory_stat(int32_t fd, stat_t* st);
 
 /*helper functions to support the f_ops*/
+uint32_t fname_hash(const uint8_t* fname);
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
 int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+void build_extents(uint32_t inode);
 
 /*file f_ops*/
 extern int32_t file_open(const uint8_t* filename);
 extern int32_t file_close(int32_t fd);
 extern int32_t file_read(int32_t fd, void* buf, int32_t nbytes);
 extern int32_t file_write(int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t file_mmap(uint32_t inode, uint8_t** start);
+extern int32_t file_seek(int32_t fd, int32_t offset, int32_t whence);
+extern int32_t file_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+extern int32_t file_stat(int32_t fd, stat_t* st);
 
 #endif
@@ -0,0 +1,305 @@
+#include "frame.h"
+#include "lib.h"
+
+/*a free block keeps its free list links in its own first bytes*/
+typedef struct free_block_t{
+	struct free_block_t* next;
+	struct free_block_t* prev;
+}free_block_t;
+
+#define FRAME_USABLE 0x40		//frame_info while frame_init sorts out the memory map
+#define FRAME_INDEX(addr) (((addr) - FRAME_POOL_START) >> FRAME_SHIFT)
+#define FRAME_ADDR(idx) (FRAME_POOL_START + ((idx) << FRAME_SHIFT))
+
+/*free blocks of each order*/
+static free_block_t* free_area[FRAME_MAX_ORDER + 1];
+/*FRAME_FREE | order on the first frame of a free block, 0 on every other frame*/
+static uint8_t frame_info[FRAME_COUNT];
+/*mappings of each allocated user page, for pages shared copy-on-write after fork*/
+static uint8_t frame_ref[FRAME_COUNT];
+static uint32_t free_frames;
+
+/*
+free_area_push - puts a block on its order's free list
+input: idx - first frame of the block, order - its order
+output: none
+effect: marks the block free so its buddy can find it
+*/
+static void free_area_push(uint32_t idx, uint32_t order){
+	free_block_t* block = (free_block_t*)FRAME_ADDR(idx);
+
+	block->next = free_area[order];
+	block->prev = NULL;
+	if(free_area[order] != NULL)
+		free_area[order]->prev = block;
+	free_area[order] = block;
+	frame_info[idx] = FRAME_FREE | order;
+}
+
+/*
+free_area_unlink - takes a block off its order's free list
+input: idx - first frame of the block, order - its order
+output: none
+effect: the block is no longer marked free
+*/
+static void free_area_unlink(uint32_t idx, uint32_t order){
+	free_block_t* block = (free_block_t*)FRAME_ADDR(idx);
+
+	if(block->prev != NULL)
+		block->prev->next = block->next;
+	else
+		free_area[order] = block->next;
+	if(block->next != NULL)
+		block->next->prev = block->prev;
+	frame_info[idx] = 0;
+}
+
+/*
+buddy_free - frees a block, merging it with its buddy while the buddy is free
+input: idx - first frame of the block, order - its order
+output: none
+effect: caller holds interrupts off
+*/
+static void buddy_free(uint32_t idx, uint32_t order){
+	uint32_t buddy;
+
+	free_frames += 1 << order;
+	while(order < FRAME_MAX_ORDER){
+		buddy = idx ^ (1 << order);
+		if(buddy >= FRAME_COUNT || frame_info[buddy] != (FRAME_FREE | order))
+			break;
+		free_area_unlink(buddy, order);
+		idx &= buddy;		//the merged block starts at the lower of the two
+		order++;
+	}
+	free_area_push(idx, order);
+}
+
+/*
+frame_mark - sets frame_info over a physical range
+input: start, end - the range, mark - FRAME_USABLE to add it, 0 to take it out
+output: none
+effect: usable ranges count only whole frames inside them, reserved ranges
+		take out every frame they touch. Anything outside the pool is ignored
+*/
+static void frame_mark(uint64_t start, uint64_t end, uint8_t mark){
+	uint32_t first, last, i;
+
+	if(start < FRAME_POOL_START)
+		start = FRAME_POOL_START;
+	if(end > FRAME_POOL_LIMIT)
+		end = FRAME_POOL_LIMIT;
+	if(start >= end)
+		return;
+	if(mark){
+		first = FRAME_INDEX((uint32_t)start + FRAME_SIZE - 1);
+		last = FRAME_INDEX((uint32_t)end);
+	}
+	else{
+		first = FRAME_INDEX((uint32_t)start);
+		last = FRAME_INDEX((uint32_t)end + FRAME_SIZE - 1);
+	}
+	for(i = first; i < last && i < FRAME_COUNT; i++)
+		frame_info[i] = mark;
+}
+
+/*
+frame_init - fills the pool from the boot loader's memory map
+input: mbi - the multiboot information
+output: none
+effect: called once paging maps the pool. Takes usable ram from the memory map,
+		or from mem_upper when there is none, less reserved ranges and boot modules,
+		and frees it into the buddy lists
+*/
+void frame_init(multiboot_info_t* mbi){
+	memory_map_t* mmap;
+	module_t* mod;
+	uint64_t base, length;
+	uint32_t i, flags;
+
+	cli_and_save(flags);
+	for(i = 0; i <= FRAME_MAX_ORDER; i++)
+		free_area[i] = NULL;
+	for(i = 0; i < FRAME_COUNT; i++)
+		frame_info[i] = 0;
+	free_frames = 0;
+
+	if(mbi->flags & MULTIBOOT_MMAP){
+		//usable entries first, so a reserved entry overlapping one wins
+		for(mmap = (memory_map_t*)mbi->mmap_addr; (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+				mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))){
+			base = ((uint64_t)mmap->base_addr_high << 32) | mmap->base_addr_low;
+			length = ((uint64_t)mmap->length_high << 32) | mmap->length_low;
+			if(mmap->type == MMAP_AVAILABLE)
+				frame_mark(base, base + length, FRAME_USABLE);
+		}
+		for(mmap = (memory_map_t*)mbi->mmap_addr; (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+				mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))){
+			base = ((uint64_t)mmap->base_addr_high << 32) | mmap->base_addr_low;
+			length = ((uint64_t)mmap->length_high << 32) | mmap->length_low;
+			if(mmap->type != MMAP_AVAILABLE)
+				frame_mark(base, base + length, 0);
+		}
+	}
+	else if(mbi->flags & MULTIBOOT_MEMINFO){
+		//mem_upper counts KB from 1MB
+		frame_mark(0x100000, 0x100000 + (uint64_t)mbi->mem_upper * 1024, FRAME_USABLE);
+	}
+
+	if(mbi->flags & MULTIBOOT_MODS){
+		mod = (module_t*)mbi->mods_addr;
+		for(i = 0; i < mbi->mods_count; i++, mod++)
+			frame_mark(mod->mod_start, mod->mod_end, 0);
+	}
+
+	for(i = 0; i < FRAME_COUNT; i++){
+		if(frame_info[i] == FRAME_USABLE){
+			frame_info[i] = 0;
+			buddy_free(i, 0);
+		}
+	}
+	restore_flags(flags);
+
+	printf("frames: %u KB free\n", free_frames * (FRAME_SIZE / 1024));
+}
+
+/*
+frame_alloc_order - takes a block of frames
+input: order - the block is 2^order frames
+output: physical address of the block, aligned to its size, 0 if none is free
+effect: splits a larger block when no block of this order is free; the halves
+		not handed out go back on the lists. Contents are left as they were
+*/
+uint32_t frame_alloc_order(uint32_t order){
+	uint32_t flags;
+	uint32_t o, idx;
+
+	if(order > FRAME_MAX_ORDER)
+		return 0;
+	cli_and_save(flags);
+	for(o = order; o <= FRAME_MAX_ORDER && free_area[o] == NULL; o++);
+	if(o > FRAME_MAX_ORDER){
+		restore_flags(flags);
+		return 0;
+	}
+	idx = FRAME_INDEX((uint32_t)free_area[o]);
+	free_area_unlink(idx, o);
+	while(o > order){
+		o--;
+		free_area_push(idx + (1 << o), o);
+	}
+	free_frames -= 1 << order;
+	frame_ref[idx] = 1;
+	restore_flags(flags);
+	return FRAME_ADDR(idx);
+}
+
+/*
+frame_free_order - gives back a block of frames
+input: addr - a block from frame_alloc_order, order - the order it was taken with
+output: none
+effect: merges it with free buddies. Ignores blocks outside the pool or misaligned
+*/
+void frame_free_order(uint32_t addr, uint32_t order){
+	uint32_t flags;
+	uint32_t idx;
+
+	if(order > FRAME_MAX_ORDER || addr < FRAME_POOL_START || addr >= FRAME_POOL_LIMIT)
+		return;
+	idx = FRAME_INDEX(addr);
+	if((addr & (FRAME_SIZE - 1)) || (idx & ((1 << order) - 1)) || idx + (1 << order) > FRAME_COUNT)
+		return;
+	cli_and_save(flags);
+	buddy_free(idx, order);
+	restore_flags(flags);
+}
+
+/*
+frame_alloc - takes a single frame
+input: none
+output: physical address of the frame, 0 if the pool is empty
+effect: the frame's contents are left as they were
+*/
+uint32_t frame_alloc(){
+	return frame_alloc_order(0);
+}
+
+/*
+frame_alloc_zeroed - takes a single frame and clears it
+input: none
+output: physical address of the frame, 0 if the pool is empty
+effect: none
+*/
+uint32_t frame_alloc_zeroed(){
+	uint32_t addr = frame_alloc();
+	if(addr != 0)
+		memset((void*)addr, 0, FRAME_SIZE);
+	return addr;
+}
+
+/*
+frame_free - gives back a single frame
+input: addr - a frame from frame_alloc
+output: none
+effect: ignores addresses outside the pool
+*/
+void frame_free(uint32_t addr){
+	frame_free_order(addr, 0);
+}
+
+/*
+frame_get - takes another reference on a frame
+input: addr - a frame from frame_alloc
+output: none
+effect: one more page table entry maps the frame
+*/
+void frame_get(uint32_t addr){
+	uint32_t flags;
+
+	if(addr < FRAME_POOL_START || addr >= FRAME_POOL_LIMIT)
+		return;
+	cli_and_save(flags);
+	frame_ref[FRAME_INDEX(addr)]++;
+	restore_flags(flags);
+}
+
+/*
+frame_put - drops a reference on a frame
+input: addr - a frame from frame_alloc
+output: none
+effect: the last reference frees the frame
+*/
+void frame_put(uint32_t addr){
+	uint32_t flags;
+	uint32_t idx;
+
+	if(addr < FRAME_POOL_START || addr >= FRAME_POOL_LIMIT)
+		return;
+	idx = FRAME_INDEX(addr);
+	cli_and_save(flags);
+	if(frame_ref[idx] > 0 && --frame_ref[idx] == 0)
+		buddy_free(idx, 0);
+	restore_flags(flags);
+}
+
+/*
+frame_refcount - references on a frame
+input: addr - a frame from frame_alloc
+output: how many page table entries map it, 0 for addresses outside the pool
+effect: none
+*/
+uint32_t frame_refcount(uint32_t addr){
+	if(addr < FRAME_POOL_START || addr >= FRAME_POOL_LIMIT)
+		return 0;
+	return frame_ref[FRAME_INDEX(addr)];
+}
+
+/*
+frame_free_count - number of free frames
+input: none
+output: frames left in the pool
+effect: none
+*/
+uint32_t frame_free_count(){
+	return free_frames;
+}
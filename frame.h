@@ -0,0 +1,47 @@
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include "types.h"
+#include "multiboot.h"
+
+/*physical frames for page directories, page tables, kernel stacks and user pages.
+  The pool is whatever the multiboot memory map reports as usable between 8MB and
+  128MB; it is identity mapped for the kernel by 4MB pages in every page directory.
+  Memory above 128MB would collide with the user windows and is left unused*/
+#define FRAME_POOL_START 0x800000	//8MB, right after the kernel page
+#define FRAME_POOL_LIMIT 0x8000000	//128MB, where the user windows start
+#define FRAME_PDE_START (FRAME_POOL_START >> 22)
+#define FRAME_PDE_END (FRAME_POOL_LIMIT >> 22)
+#define FRAME_SIZE 0x1000
+#define FRAME_SHIFT 12
+#define FRAME_COUNT ((FRAME_POOL_LIMIT - FRAME_POOL_START) >> FRAME_SHIFT)
+
+/*buddy orders: a block of order n is 2^n frames, aligned to its size*/
+#define FRAME_ORDER_4MB 10
+#define FRAME_MAX_ORDER FRAME_ORDER_4MB
+#define FRAME_FREE 0x80			//frame_info: first frame of a free block, low bits its order
+
+/*memory map entry type of usable ram*/
+#define MMAP_AVAILABLE 1
+
+/*fills the pool from the boot loader's memory map*/
+extern void frame_init(multiboot_info_t* mbi);
+/*a free block of 2^order frames, 0 if none is left*/
+extern uint32_t frame_alloc_order(uint32_t order);
+/*gives back a block from frame_alloc_order*/
+extern void frame_free_order(uint32_t addr, uint32_t order);
+/*a free frame, 0 if none is left*/
+extern uint32_t frame_alloc();
+/*a free frame filled with zeros, 0 if none is left*/
+extern uint32_t frame_alloc_zeroed();
+/*gives a frame back*/
+extern void frame_free(uint32_t addr);
+/*reference counts of user pages shared copy-on-write; frame_alloc starts at 1*/
+extern void frame_get(uint32_t addr);
+/*the last reference frees the frame*/
+extern void frame_put(uint32_t addr);
+extern uint32_t frame_refcount(uint32_t addr);
+/*frames left in the pool*/
+extern uint32_t frame_free_count();
+
+#endif
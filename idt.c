@@ -2,6 +2,8 @@
 
 #include "x86_desc.h"
 #include "lib.h"
+#include "paging.h"
+#include "filesys.h"
 
 /********************************************************************
 
@@ -12,7 +14,7 @@ We need to implement user level process termination in exception_common()
 **************************************************************/
 /*  Address of handler functions typecasted into integer type */
 int idt_handler_addr[256] = {(int)&divide_by_zero, (int)&debug, (int)&NMI, (int)&breakpoint, (int)&overflow, (int)&bound_range_exceeded, (int)&invalid_opcode, (int)&device_not_available,
-						(int)&double_fault, (int)&segment_overrun, (int)&invalid_TSS, (int)&segment_not_present, (int)&stack_segment_fault, (int)&general_protection_fault, (int)&page_fault, (int)&reserved_exception_1,
+						(int)&double_fault, (int)&segment_overrun, (int)&invalid_TSS, (int)&segment_not_present, (int)&stack_segment_fault, (int)&general_protection_fault, (int)&page_fault_wrapper, (int)&reserved_exception_1,
 						(int)&floating_point_exception_87, (int)&alignment_check, (int)&machine_check, (int)&floating_point_exception_SIMD, (int)&virtualization_exception, (int)&reserved_exception_3, (int)&reserved_exception_4,
 						(int)&reserved_exception_5, (int)&reserved_exception_6, (int)&reserved_exception_7, (int)&reserved_exception_8, (int)&reserved_exception_9, (int)&reserved_exception_10, (int)&security_exception, (int)&reserved_exception_11};
 
@@ -75,6 +77,10 @@ int i;
 		idt_trap(i);
 		SET_IDT_ENTRY(idt[i], idt_handler_addr[i]);
 	}
+	/*page faults come in with interrupts off: a tick could otherwise run another
+	  process that faults and overwrites cr2 before page_fault reads it, and the
+	  demand paging path it takes has no locks of its own*/
+	idt_interrupt(PAGE_FAULT_VECTOR);
 	//fill rest with "nothing"
 	for(i = 32; i < 256; i ++)
 	{
@@ -173,9 +179,30 @@ void general_protection_fault()
 	printf("Exception : General Protection Fault");
 	exception_common();
 }
-void page_fault()
+/*
+page_fault - page fault handler, called from page_fault_wrapper
+input: error_code - the error code pushed by the cpu
+output: none
+effect: maps and loads a not-present page of the current program's window on demand,
+		and copies a copy-on-write page that is written. Any other fault is fatal.
+		Entered through an interrupt gate, so nothing else runs until it returns
+*/
+void page_fault(uint32_t error_code)
 {
-	printf("Exception : Page Fault");
+	uint32_t fault_addr;
+	asm volatile ("movl %%cr2, %0"
+				: "=r"(fault_addr));
+
+	if(!(error_code & PF_PRESENT) && curr_pcb != NULL &&
+		fault_addr >= USER_VMEM_START && fault_addr < USER_VMEM_END)
+	{
+		if(program_load_page(fault_addr) == 0)
+			return;
+	}
+	if((error_code & PF_PRESENT) && (error_code & PF_WRITE) && curr_pcb != NULL &&
+		curr_pcb->pid < PROCESS_MAX && cow_fault(curr_pcb->pid, fault_addr) == 0)
+		return;
+	printf("Exception : Page Fault at 0x%x", fault_addr);
 	exception_common();
 }
 void reserved_exception_1()
@@ -3,6 +3,11 @@
 #include "types.h"
 #include "syscall_linker.h"
 
+#define PAGE_FAULT_VECTOR 14
+/*page fault error code bits*/
+#define PF_PRESENT 0x1
+#define PF_WRITE 0x2
+
 /*  Address of handler functions typecasted into integer type */
 
 int idt_handler_addr[256];
@@ -32,7 +37,8 @@ extern void invalid_TSS();							//vector: 0xA
 extern void segment_not_present();					//vector: 0xB
 extern void stack_segment_fault();					//vector: 0xC
 extern void general_protection_fault();			//vector: 0xD
-extern void page_fault();							//vector: 0xE
+extern void page_fault(uint32_t error_code);		//vector: 0xE
+extern void page_fault_wrapper();					//assembly linkage for page_fault
 extern void reserved_exception_1();				//vector: 0xF
 
 extern void floating_point_exception_87();			//vector: 0x10
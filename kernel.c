@@ -15,6 +15,8 @@
 #include "terminal.h"
 #include "pcb.h"
 #include "schedule.h"
+#include "syscalls.h"
+#include "clock.h"
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
@@ -59,8 +61,10 @@ entry (unsigned long magic, unsigned long addr)
 		printf ("boot_device = 0x%#x\n", (unsigned) mbi->boot_device);
 
 	/* Is the command line passed? */
-	if (CHECK_FLAG (mbi->flags, 2))
+	if (CHECK_FLAG (mbi->flags, 2)) {
 		printf ("cmdline = %s\n", (char *) mbi->cmdline);
+		sched_parse_cmdline((int8_t *) mbi->cmdline);
+	}
 
 	if (CHECK_FLAG (mbi->flags, 3)) {
 		int mod_count = 0;
@@ -171,17 +175,22 @@ entry (unsigned long magic, unsigned long addr)
 	/* Init the IDT */
 	IDT_init();
 	lidt(idt_desc_ptr);
+	sysenter_init();
+	pid_init();
 	
 	/* Initialize devices, memory, filesystem, enable device interrupts on the
 	 * PIC, any other initialization stuff... */
 	keyboard_init();
+	terminal_init();
 
 	/*enable rtc*/
 	rtc_int_enable();
 	rtc_init();
-	rtc_set_frequency(15);						//set rate bits to all high which is 2hz
+	rtc_set_frequency(RTC_MAX_RATE);			//fastest rate any descriptor can ask for
+	clock_init();								//tsc rate and wall clock
 
-	paging_init();
+	paging_init(mbi);
+	pcb_cache_init();
 
 	/* Enable interrupts */
 	keyboard_int_enable();
@@ -368,11 +377,9 @@ while(1)
 	printf("closed fd gets: %d\n", closed_fd);
 */
 
-	//init_scheduler();
-
-	/* Execute the first program (`shell') ... */
-
-	execute((uint8_t *)"shell");
+	/* Execute the first program (`shell') on every terminal and start
+	 * switching between them; this does not return */
+	sched_start();
 	//execute("testprint");
 	
 	/* Spin (nicely, so we don't chew up cycles) */
@@ -4,6 +4,7 @@
 #include "x86_desc.h"
 #include "idt.h"
 #include "terminal.h"
+#include "schedule.h"
 
 uint8_t get_key[128];
 int key_idx = 0;
@@ -276,8 +277,9 @@ extern void keyboard_handler()
 		{
 			/*print character to screen*/
 			//printf("%c",c);
-			keyboard_helper((unsigned char)c);
+			terminal_input((unsigned char)c);
 			send_eoi(KEYBOARD_IRQ);
+			sched_preempt();	//run a reader woken by enter right away
 			return;
 		}
 	}
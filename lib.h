@@ -34,6 +34,24 @@ extern void test_interrupts(void);
 int32_t bad_userspace_addr(const void* addr, int32_t len);
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 
+#ifdef HOST_BENCH
+
+/* The host benchmark and test harnesses (tools/bench, tools/test) run kernel
+ * code in user space, where port I/O and changes to the interrupt flag would
+ * fault */
+#define inb(port) 0
+#define inw(port) 0
+#define inl(port) 0
+#define outb(data, port) do { } while(0)
+#define outw(data, port) do { } while(0)
+#define outl(data, port) do { } while(0)
+#define cli() do { } while(0)
+#define cli_and_save(flags) do { (flags) = 0; } while(0)
+#define sti() do { } while(0)
+#define restore_flags(flags) do { (void)(flags); } while(0)
+
+#else
+
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
  * unsigned int */
@@ -148,4 +166,6 @@ do {                                    \
 			);                      \
 } while(0)
 
+#endif /* HOST_BENCH */
+
 #endif /* _LIB_H */
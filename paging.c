@@ -1,46 +1,82 @@
 #include "paging.h"
 #include "lib.h"
+#include "frame.h"
+#include "syscalls.h"
 
 uint32_t process_number;
 /* Structures required for paging */
-static uint32_t page_directory[7][PAGE_DIRECTORY_SIZE] __attribute__((aligned (0x4000)));
+static uint32_t page_directory[PAGE_DIRECTORY_SIZE] __attribute__((aligned (0x4000)));	//kernel only, used until the first exec and copied into every process directory
 static uint32_t page_table[PAGE_TABLE_SIZE] __attribute__((aligned (0x4000)));
-static uint32_t new_page_table[PAGE_TABLE_SIZE] __attribute__((aligned (0x4000)));
 static uint32_t video_page_table[3][PAGE_TABLE_SIZE] __attribute__((aligned (0x4000)));
 
+/*each process's page directory and tables, taken from the frame pool by
+  new_process_init; the mmap table only once the process calls mmap*/
+static uint32_t* proc_dir[PROCESS_MAX];
+static uint32_t* user_page_table[PROCESS_MAX];
+static uint32_t* mmap_page_table[PROCESS_MAX];
+/*next free page of each process's mmap window*/
+static uint32_t mmap_next[PROCESS_MAX];
+
+/*tables of the last process to halt; its directory may still be in cr3 when it
+  releases them, so they are freed at the next release instead*/
+static uint32_t retired_frames[3];
+
+/*shared text frames, chained by hash of (inode, page)*/
+static shared_page_t shared_pages[SHARED_PAGE_MAX];
+static uint32_t shared_text_base;	//4MB block holding them, 0 if the pool had none
+static int32_t shared_hash[SHARED_HASH_SIZE];
+
 
 /*
 paging_init - initializes paging
-input: none
+input: mbi - multiboot information, for the memory map
 output: none
-effect: sets up the paging directories and tables, moves correct values into cr registers 
+effect: sets up the paging directories and tables, moves correct values into cr registers,
+		then fills the frame pool and takes the shared text block from it
 */
-void paging_init()
+void paging_init(multiboot_info_t* mbi)
 {
 	process_number = 0;	//set process = 0
 	
 	uint32_t cr4;
 	uint32_t cr0;
+	uint32_t eax, ebx, ecx, edx;	//cpuid leaf 1
 	int i; //counter for loops
 
 	/* initialize page directory/ries -- empty */
 	for(i=0; i < PAGE_DIRECTORY_SIZE; i++)
 	{
-		page_directory[0][i] = RW_FLAG;		//set read/write bit
+		page_directory[i] = RW_FLAG;		//set read/write bit
 	}
 
-	/* initialize page table(s) -- empty */
+	/* initialize page table(s) -- the low 4MB, shared by every process and never rewritten */
 	for(i=0; i < PAGE_TABLE_SIZE; i++)
 	{
-		page_table[i] = i*0x1000 | 0x03;
+		page_table[i] = i*0x1000 | GLOBAL_FLAG | RW_FLAG | PRESENT_FLAG;
 	}	
 	
 	//[0] for video memory
-	page_directory[0][0] = (uint32_t)page_table | USER_FLAG | RW_FLAG | PRESENT_FLAG; //SU, presents
-	page_directory[0][1] = KERNEL_loc; //kernel - we'll set PSE so we can circumvent page table!
+	page_directory[0] = (uint32_t)page_table | USER_FLAG | RW_FLAG | PRESENT_FLAG; //SU, presents
+	page_directory[1] = KERNEL_loc; //kernel - we'll set PSE so we can circumvent page table!
+	//frame pool, kernel only; covers the whole range the pool may use
+	for(i=FRAME_PDE_START; i < FRAME_PDE_END; i++)
+	{
+		page_directory[i] = (i << 22) | GLOBAL_FLAG | PAGE_SIZE_FLAG | RW_FLAG | PRESENT_FLAG;
+	}
 
 	page_table[VIDEO_MEM_OFFSET] = 0x000B8003; //not "messing" with kernel, so R is 0
 										//for future reference, other pages should be 0x000B8007
+										//not global: map_video_mem moves it between terminals
+
+	/* no shared text frames yet */
+	for(i=0; i < SHARED_HASH_SIZE; i++)
+	{
+		shared_hash[i] = SHARED_NONE;
+	}
+	for(i=0; i < SHARED_PAGE_MAX; i++)
+	{
+		shared_pages[i].in_use = 0;
+	}
 
 
 	/* ENABLE PAGING */									
@@ -50,10 +86,16 @@ void paging_init()
 				:
 				: "a"(page_directory)); 
 
-	/* set the PSE flag (bit 5) of our local copy of CR4 */
+	/* set the PSE flag (bit 5) of our local copy of CR4, and PGE so the global
+	   kernel mappings stay in the TLB when cr3 changes */
+	asm volatile ("cpuid"
+				: "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+				: "a"(1));
 	asm volatile ("mov %%CR4, %0"
 				: "=b"(cr4));
 	cr4 = cr4 | 0x00000010; //0x10
+	if(edx & CPUID_PGE)
+		cr4 = cr4 | CR4_PGE;
 	asm volatile ("mov %0, %%CR4"
 				:
 				: "a"(cr4));
@@ -61,10 +103,43 @@ void paging_init()
 	/* enable paging by setting CR0 accordingly ( bit 31) */
 	asm volatile ("mov %%CR0, %0"
 				: "=b"(cr0));
-	cr0 = cr0 | 0x80000000;
+	cr0 = cr0 | 0x80000000 | CR0_WP;	//WP: the kernel's writes to user pages honour read-only too, for copy-on-write
 	asm volatile ("mov %0, %%CR0"
 				:
 				: "a"(cr0));
+
+	frame_init(mbi);
+	shared_text_base = frame_alloc_order(FRAME_ORDER_4MB);
+}
+
+/*
+process_dir_alloc - builds a page directory for a process
+input: process-num - the process
+output: 0 for success, -1 for fail
+effect: the directory and the window's page table come from the frame pool; the
+		window starts out empty. The kernel entries are copied from page_directory,
+		which paging_init built once. Does not switch to it
+*/
+static int32_t process_dir_alloc(uint32_t process_num){
+	uint32_t * process_page = (uint32_t *)frame_alloc_zeroed();		//the new process's page directory
+	uint32_t * user_table = (uint32_t *)frame_alloc_zeroed();			//its program window, not present until touched
+	if(process_page == NULL || user_table == NULL){
+		frame_free((uint32_t)process_page);
+		frame_free((uint32_t)user_table);
+		return -1;
+	}
+	proc_dir[process_num] = process_page;
+	user_page_table[process_num] = user_table;
+	mmap_page_table[process_num] = NULL;
+	mmap_next[process_num] = 0;
+
+	//low 4MB, kernel page and frame pool, the same in every directory
+	memcpy(process_page, page_directory, KERNEL_PDE_END * sizeof(uint32_t));
+	
+	//program window starts out not present, pages are filled in on first touch
+	process_page[USER_PDE_INDEX] = (uint32_t)user_table | USER_FLAG | RW_FLAG | PRESENT_FLAG;
+	//the mmap window and vidmap stay not present until the process asks for them
+	return 0;
 }
 
 /*
@@ -73,26 +148,15 @@ input: process-num - the process number to initialize
 output: 0 for success, -1 for fail
 effect: creates and switches to a new page directory for the new process
 */
-//0x80 = page size, 0x100 = global flag, 0x1000 = page address 
 int32_t new_process_init(uint32_t process_num){
-	if(process_num>=6)
-		return -1;		//6 is max amount of processes	
-	uint32_t * process_page = (uint32_t *)(page_directory[process_num]);		//get address for the new process's place in page directory
-	unsigned int i;									//counter
-	for(i=0; i < PAGE_TABLE_SIZE; i++){				//iterate over the page
-		/* new_*/page_table[i]= (i * 0x1000) | GLOBAL_FLAG /*0x80*/ | RW_FLAG | PRESENT_FLAG ;			//activate supervisor level, global flag, r/w, and mark as present
-	}
-	/*new_ */page_table[VIDEO_MEM_OFFSET] = 0x000B8003;
-	
-	process_page[0] = (((uint32_t) /* new_ */page_table) >> 12) << 12 | USER_FLAG | RW_FLAG | PRESENT_FLAG;	//set first entry
-	process_page[1] = 0x400000 | GLOBAL_FLAG | PAGE_SIZE_FLAG | RW_FLAG | PRESENT_FLAG;	//set kernel entry
-	process_page[0x20] = ((process_num+1)*0x400000 + 0x400000) | PAGE_SIZE_FLAG | USER_FLAG | RW_FLAG | PRESENT_FLAG;
+	if(process_num>=PROCESS_MAX || process_dir_alloc(process_num) == -1)
+		return -1;
 	
 	//set the control registers to the page
 	asm volatile (
 	"movl %0, %%eax;"	//place address to process's page into eax
 			:
-			: "a"(process_page));
+			: "a"(proc_dir[process_num]));
 			
 	asm volatile (
 	//"andl $0xFFFFFFE7, %eax;"
@@ -102,58 +166,409 @@ int32_t new_process_init(uint32_t process_num){
 }
 
 /*
-_4kb_video_page - creates a 4kb video page 
-input: none
-output: virtual address of the mapping
-effect: creates a 4kb video page that maps to video memory that is user accessable
+map_user_page - maps one 4kb page of a process's program window
+input: process_num - the process that owns the window, vaddr - address in the window
+output: 0 for success, -1 for fail
+effect: backs the page with a frame from the pool and flushes it from the TLB.
+		The frame is not cleared; the caller fills it
 */
-int32_t _4kb_video_page(){
+int32_t map_user_page(uint32_t process_num, uint32_t vaddr){
+	if(process_num>=PROCESS_MAX || user_page_table[process_num] == NULL || vaddr < USER_VMEM_START || vaddr >= USER_VMEM_END)
+		return -1;
+	uint32_t page = vaddr & PAGE_ADDR_MASK;
+	uint32_t idx = (page - USER_VMEM_START) / PAGE_SIZE_4KB;
+	uint32_t frame;
+	if(user_page_table[process_num][idx] & PRESENT_FLAG)
+		return -1;		//already mapped, not a demand fault
+	frame = frame_alloc();
+	if(frame == 0)
+		return -1;
+	user_page_table[process_num][idx] = frame | USER_FLAG | RW_FLAG | PRESENT_FLAG;
+	asm volatile ("invlpg (%0)"
+				:
+				: "r"(page)
+				: "memory");
+	return 0;
+}
 
-	uint32_t * process_page = (uint32_t *)(page_directory[process_number-1]);
-	process_page[33] = (uint32_t) new_page_table | USER_FLAG | RW_FLAG | PRESENT_FLAG;
-	new_page_table[0] = 0x0B8000 | USER_FLAG | RW_FLAG | PRESENT_FLAG;
-	asm volatile ("movl	%cr3,%eax;");
-	asm volatile ("movl	%eax,%cr3;");
-	return 33*0x400000;
-/*	
-	uint32_t * process_page = (uint32_t *)(page_directory[process_number]);
-	if(!(process_page[31] & 0x1))	//check if user bit is present
+/*
+shared_page_hash - hash bucket of a shared text page
+input: inode - inode of the image, page_idx - page within the image
+output: index into shared_hash
+effect: none
+*/
+static uint32_t shared_page_hash(uint32_t inode, uint32_t page_idx){
+	return (inode * 31 + page_idx) & (SHARED_HASH_SIZE - 1);
+}
+
+/*
+shared_page_unlink - drops a shared text frame from its hash chain
+input: idx - the entry to drop
+output: none
+effect: the frame can be handed out for another page
+*/
+static void shared_page_unlink(int32_t idx){
+	int32_t* link = &shared_hash[shared_page_hash(shared_pages[idx].inode, shared_pages[idx].page_idx)];
+	while(*link != SHARED_NONE){
+		if(*link == idx){
+			*link = shared_pages[idx].next;
+			break;
+		}
+		link = &shared_pages[*link].next;
+	}
+	shared_pages[idx].in_use = 0;
+}
+
+/*
+map_shared_page - maps a read-only text page shared by every process running the same image
+input: process_num - the process that faulted, vaddr - address in its window,
+		inode - inode of the image, page_idx - page within the image
+output: 1 if the frame is new and must be filled, 0 if it already holds the page, -1 if no frame is free
+effect: maps the frame read-only and takes a reference on it. Unreferenced frames stay
+		cached for the next exec of the same image until their slot is needed
+*/
+int32_t map_shared_page(uint32_t process_num, uint32_t vaddr, uint32_t inode, uint32_t page_idx){
+	uint32_t page, bucket;
+	int32_t idx, victim, fresh;
+
+	if(process_num>=PROCESS_MAX || user_page_table[process_num] == NULL || vaddr < USER_VMEM_START || vaddr >= USER_VMEM_END)
 		return -1;
-	process_page[31] = (0x0B8000) | USER_FLAG | RW_FLAG | PRESENT_FLAG;	//set it to user, rw, and present 
-	return (int32_t) &process_page[31];
+	if(shared_text_base == 0)
+		return -1;		//no shared frames, the caller loads a private copy
+	page = vaddr & PAGE_ADDR_MASK;
+	bucket = shared_page_hash(inode, page_idx);
+
+	/*look for a frame that already holds this page*/
+	fresh = 0;
+	for(idx = shared_hash[bucket]; idx != SHARED_NONE; idx = shared_pages[idx].next){
+		if(shared_pages[idx].inode == inode && shared_pages[idx].page_idx == page_idx)
+			break;
+	}
+
+	if(idx == SHARED_NONE){
+		/*take a free frame, else recycle one no process maps*/
+		victim = SHARED_NONE;
+		for(idx = 0; idx < SHARED_PAGE_MAX; idx++){
+			if(!shared_pages[idx].in_use)
+				break;
+			if(victim == SHARED_NONE && shared_pages[idx].ref_count == 0)
+				victim = idx;
+		}
+		if(idx == SHARED_PAGE_MAX){
+			if(victim == SHARED_NONE)
+				return -1;
+			shared_page_unlink(victim);
+			idx = victim;
+		}
+		shared_pages[idx].inode = inode;
+		shared_pages[idx].page_idx = page_idx;
+		shared_pages[idx].ref_count = 0;
+		shared_pages[idx].in_use = 1;
+		shared_pages[idx].next = shared_hash[bucket];
+		shared_hash[bucket] = idx;
+		fresh = 1;
+	}
+
+	shared_pages[idx].ref_count++;
+	//read-only; the caller fills a fresh frame through user_page_frame
+	user_page_table[process_num][(page - USER_VMEM_START) / PAGE_SIZE_4KB] =
+		(shared_text_base + idx * PAGE_SIZE_4KB) | SHARED_FLAG | USER_FLAG | PRESENT_FLAG;
+	asm volatile ("invlpg (%0)"
+				:
+				: "r"(page)
+				: "memory");
+	return fresh;
+}
+
+/*
+mmap_reserve - sets aside pages of a process's mmap window
+input: process_num - the process mapping a file, npages - number of 4kb pages
+output: virtual address of the first page, -1 if the window is full
+effect: the first call gives the process a page table for the window; nothing is
+		mapped until the pages are filled in with map_file_page
 */
+int32_t mmap_reserve(uint32_t process_num, uint32_t npages){
+	uint32_t start;
+	uint32_t table;
+	if(process_num>=PROCESS_MAX || proc_dir[process_num] == NULL || npages > PAGE_TABLE_SIZE - mmap_next[process_num])
+		return -1;
+	if(mmap_page_table[process_num] == NULL){
+		table = frame_alloc_zeroed();
+		if(table == 0)
+			return -1;
+		mmap_page_table[process_num] = (uint32_t*)table;
+		proc_dir[process_num][MMAP_PDE_INDEX] = table | USER_FLAG | RW_FLAG | PRESENT_FLAG;
+	}
+	start = MMAP_VMEM_START + mmap_next[process_num] * PAGE_SIZE_4KB;
+	mmap_next[process_num] += npages;
+	return start;
 }
 
 /*
-restore_paging - restores the paging for the previous process after one is finished
-input: proc_num - the process that is finishing
-output: 0
-effect: restores the cr3 register to the previous process
+map_file_page - maps a filesystem data block read-only into a process's mmap window
+input: process_num - the process mapping the file, vaddr - address in the window,
+		paddr - 4kb aligned address of the data block
+output: 0 for success, -1 for fail
+effect: the user can read the block in place, no copy is made
 */
+int32_t map_file_page(uint32_t process_num, uint32_t vaddr, uint32_t paddr){
+	uint32_t page;
+	if(process_num>=PROCESS_MAX || mmap_page_table[process_num] == NULL || vaddr < MMAP_VMEM_START || vaddr >= MMAP_VMEM_END || (paddr & ~PAGE_ADDR_MASK))
+		return -1;
+	page = vaddr & PAGE_ADDR_MASK;
+	mmap_page_table[process_num][(page - MMAP_VMEM_START) / PAGE_SIZE_4KB] = paddr | USER_FLAG | PRESENT_FLAG;
+	asm volatile ("invlpg (%0)"
+				:
+				: "r"(page)
+				: "memory");
+	return 0;
+}
 
-void disable_vidmem(uint32_t PID, uint8_t *video_buffer, uint32_t terminal_no)
-{
-	uint32_t * process_page = (uint32_t *)(page_directory[PID]);
-	process_page[33] = (uint32_t)video_page_table[terminal_no] | USER_FLAG | RW_FLAG | PRESENT_FLAG;
-	video_page_table[terminal_no][0] = (uint32_t)video_buffer | USER_FLAG | RW_FLAG | PRESENT_FLAG;
+/*
+user_page_drop - gives back the frame behind one page of a process's window
+input: process_num - the process, idx - the page's entry in the window's page table
+output: none
+effect: frees a private frame or drops the reference on a shared text frame; the
+		entry is cleared but the TLB is left to the caller
+*/
+static void user_page_drop(uint32_t process_num, uint32_t idx){
+	uint32_t pte = user_page_table[process_num][idx];
+	if(!(pte & PRESENT_FLAG))
+		return;
+	if(pte & SHARED_FLAG)
+		shared_pages[((pte & PAGE_ADDR_MASK) - shared_text_base) / PAGE_SIZE_4KB].ref_count--;
+	else
+		frame_put(pte & PAGE_ADDR_MASK);	//may still be mapped copy-on-write by a fork
+	user_page_table[process_num][idx] = 0;
+}
+
+/*
+user_page_frame - where the kernel can reach a mapped page of a process's window
+input: process_num - the process, vaddr - address in its window
+output: the frame's address in the kernel's identity map of the pool, 0 if not mapped
+effect: none. Lets the kernel fill read-only pages, which CR0.WP keeps it from
+		writing through the user mapping
+*/
+uint32_t user_page_frame(uint32_t process_num, uint32_t vaddr){
+	uint32_t pte;
+	if(process_num>=PROCESS_MAX || user_page_table[process_num] == NULL || vaddr < USER_VMEM_START || vaddr >= USER_VMEM_END)
+		return 0;
+	pte = user_page_table[process_num][(vaddr - USER_VMEM_START) / PAGE_SIZE_4KB];
+	if(!(pte & PRESENT_FLAG))
+		return 0;
+	return pte & PAGE_ADDR_MASK;
+}
+
+/*
+fork_user_pages - gives a forked process a copy-on-write view of its parent's memory
+input: parent - the running process, child - the new one
+output: 0 for success, -1 if the frame pool is out
+effect: builds the child's directory. Private pages of both become read-only and
+		copy-on-write, with one more reference on their frame; shared text, file
+		mappings and vidmap are mapped as they are. Flushes the parent's TLB
+*/
+int32_t fork_user_pages(uint32_t parent, uint32_t child){
+	uint32_t i, pte, table;
+	if(parent>=PROCESS_MAX || child>=PROCESS_MAX || proc_dir[parent] == NULL)
+		return -1;
+	if(process_dir_alloc(child) == -1)
+		return -1;
+	if(mmap_page_table[parent] != NULL){
+		table = frame_alloc();
+		if(table == 0){
+			release_user_pages(child);
+			return -1;
+		}
+		//file system blocks, not counted per mapping
+		memcpy((void*)table, mmap_page_table[parent], PAGE_SIZE_4KB);
+		mmap_page_table[child] = (uint32_t*)table;
+		mmap_next[child] = mmap_next[parent];
+		proc_dir[child][MMAP_PDE_INDEX] = table | USER_FLAG | RW_FLAG | PRESENT_FLAG;
+	}
+	proc_dir[child][VIDMAP_PDE_INDEX] = proc_dir[parent][VIDMAP_PDE_INDEX];
+
+	for(i=0; i < PAGE_TABLE_SIZE; i++){
+		pte = user_page_table[parent][i];
+		if(!(pte & PRESENT_FLAG))
+			continue;
+		if(pte & SHARED_FLAG){
+			shared_pages[((pte & PAGE_ADDR_MASK) - shared_text_base) / PAGE_SIZE_4KB].ref_count++;
+		}
+		else{
+			if(pte & RW_FLAG){
+				pte = (pte & ~RW_FLAG) | COW_FLAG;
+				user_page_table[parent][i] = pte;
+			}
+			frame_get(pte & PAGE_ADDR_MASK);
+		}
+		user_page_table[child][i] = pte;
+	}
+
+	//the parent's writable pages just became read-only
+	asm volatile ("movl %%cr3, %%eax; movl %%eax, %%cr3"
+				:
+				:
+				: "eax", "memory");
+	return 0;
+}
+
+/*
+cow_fault - resolves a write to a copy-on-write page
+input: process_num - the process that faulted, vaddr - the address written
+output: 0 if the page is writable now, -1 if it is not a copy-on-write page or
+		no frame is free
+effect: the last process mapping the frame takes it over; others get a copy
+*/
+int32_t cow_fault(uint32_t process_num, uint32_t vaddr){
+	uint32_t page, idx, pte, frame, copy;
+	uint32_t flags;
+	if(process_num>=PROCESS_MAX || user_page_table[process_num] == NULL || vaddr < USER_VMEM_START || vaddr >= USER_VMEM_END)
+		return -1;
+	page = vaddr & PAGE_ADDR_MASK;
+	idx = (page - USER_VMEM_START) / PAGE_SIZE_4KB;
+	cli_and_save(flags);
+	pte = user_page_table[process_num][idx];
+	if(!(pte & PRESENT_FLAG) || !(pte & COW_FLAG)){
+		restore_flags(flags);
+		return -1;
+	}
+	frame = pte & PAGE_ADDR_MASK;
+	if(frame_refcount(frame) == 1){
+		user_page_table[process_num][idx] = (pte & ~COW_FLAG) | RW_FLAG;
+	}
+	else{
+		copy = frame_alloc();
+		if(copy == 0){
+			restore_flags(flags);
+			return -1;
+		}
+		memcpy((void*)copy, (void*)frame, PAGE_SIZE_4KB);
+		user_page_table[process_num][idx] = copy | USER_FLAG | RW_FLAG | PRESENT_FLAG;
+		frame_put(frame);
+	}
+	asm volatile ("invlpg (%0)"
+				:
+				: "r"(page)
+				: "memory");
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+unmap_user_pages - unmaps part of a process's window
+input: process_num - the process, start, end - page aligned range in the window
+output: none
+effect: the pages go back to the pool and fault in as new zero pages if touched again
+*/
+void unmap_user_pages(uint32_t process_num, uint32_t start, uint32_t end){
+	uint32_t page;
+	if(process_num>=PROCESS_MAX || user_page_table[process_num] == NULL)
+		return;
+	if(start < USER_VMEM_START)
+		start = USER_VMEM_START;
+	if(end > USER_VMEM_END)
+		end = USER_VMEM_END;
+	for(page = start; page < end; page += PAGE_SIZE_4KB){
+		user_page_drop(process_num, (page - USER_VMEM_START) / PAGE_SIZE_4KB);
+		asm volatile ("invlpg (%0)"
+					:
+					: "r"(page)
+					: "memory");
+	}
+}
+
+/*
+release_user_pages - gives back everything a process's paging holds
+input: process_num - the process that is finishing
+output: none
+effect: frees the window's private frames and drops its references on shared text
+		frames, which stay cached. The directory and tables are retired: the caller
+		is still running on them, so they go back to the pool on the next release
+*/
+void release_user_pages(uint32_t process_num){
+	uint32_t i;
+	if(process_num>=PROCESS_MAX || proc_dir[process_num] == NULL)
+		return;
+	for(i=0; i < PAGE_TABLE_SIZE; i++){
+		user_page_drop(process_num, i);
+	}
+	//mmap pages are file system blocks, not the process's own
+
+	for(i=0; i < 3; i++){
+		frame_free(retired_frames[i]);
+	}
+	retired_frames[0] = (uint32_t)proc_dir[process_num];
+	retired_frames[1] = (uint32_t)user_page_table[process_num];
+	retired_frames[2] = (uint32_t)mmap_page_table[process_num];
+	proc_dir[process_num] = NULL;
+	user_page_table[process_num] = NULL;
+	mmap_page_table[process_num] = NULL;
+	mmap_next[process_num] = 0;
+}
+
+/*
+_4kb_video_page - creates a 4kb video page 
+input: process_num - the process asking, terminal_no - its terminal,
+		addr - where the terminal's video memory is right now
+output: virtual address of the mapping
+effect: creates a 4kb video page that maps to video memory that is user accessable.
+		Each terminal has its own page table, so remap_vidmem moves every process
+		of the terminal at once when it goes on or off screen
+*/
+int32_t _4kb_video_page(uint32_t process_num, uint32_t terminal_no, uint32_t addr){
+	if(process_num>=PROCESS_MAX || proc_dir[process_num] == NULL)
+		return -1;
+	uint32_t * process_page = proc_dir[process_num];
+	process_page[VIDMAP_PDE_INDEX] = (uint32_t)video_page_table[terminal_no] | USER_FLAG | RW_FLAG | PRESENT_FLAG;
+	video_page_table[terminal_no][0] = addr | USER_FLAG | RW_FLAG | PRESENT_FLAG;
 	asm volatile ("movl	%cr3,%eax;");
 	asm volatile ("movl	%eax,%cr3;");
+	return VIDMAP_PDE_INDEX*0x400000;
+}
+
+/*
+map_video_mem - points the kernel's view of video memory somewhere
+input: addr - 4kb aligned address to show at 0xB8000, the screen or a terminal's buffer
+output: none
+effect: everything drawn through 0xB8000 goes to addr until the next call
+*/
+void map_video_mem(uint32_t addr){
+	page_table[VIDEO_MEM_OFFSET] = addr | RW_FLAG | PRESENT_FLAG;
+	asm volatile ("invlpg (%0)"
+				:
+				: "r"(VIDEO)
+				: "memory");
 }
-void enable_vidmem(uint32_t PID, uint32_t terminal_no)
+
+/*
+remap_vidmem - moves the vidmap page of a terminal's processes
+input: terminal_no - the terminal, addr - the screen or the terminal's buffer
+output: none
+effect: processes that called vidmap keep drawing to their own terminal
+*/
+void remap_vidmem(uint32_t terminal_no, uint32_t addr)
 {
-	uint32_t * process_page = (uint32_t *)(page_directory[PID]);
-	process_page[33] = (uint32_t)video_page_table[terminal_no] | USER_FLAG | RW_FLAG | PRESENT_FLAG;
-	video_page_table[terminal_no][0] = 0x0B8000 | USER_FLAG | RW_FLAG | PRESENT_FLAG;
-	asm volatile ("movl	%cr3,%eax;");
-	asm volatile ("movl	%eax,%cr3;");
+	video_page_table[terminal_no][0] = addr | USER_FLAG | RW_FLAG | PRESENT_FLAG;
+	asm volatile ("invlpg (%0)"
+				:
+				: "r"(VIDMAP_PDE_INDEX*0x400000)
+				: "memory");
 }
 
+/*
+restore_paging - restores the paging for the previous process after one is finished
+input: proc_num - the process that is finishing
+output: 0
+effect: restores the cr3 register to the previous process
+*/
 
 int32_t restore_paging(uint32_t proc_num){
 	//printf("proc_num = %d", proc_num);
+	if(proc_num>=PROCESS_MAX || proc_dir[proc_num] == NULL)
+		return -1;
 	asm volatile ("movl %0, %%eax"
 			:
-			: "a"(&(page_directory[proc_num])));
+			: "a"(proc_dir[proc_num]));
 	asm volatile ("movl %eax, %cr3");
 	return 0;
 }
@@ -2,6 +2,7 @@
 #define _PAGING_H
 
 #include "x86_desc.h"
+#include "multiboot.h"
 
 
 #define GLOBAL_FLAG 0x100
@@ -10,16 +11,63 @@
 #define RW_FLAG 0x2
 #define PRESENT_FLAG 0x1
 #define PAGE_4MB 0x80 
+#define SHARED_FLAG 0x200	//available bit: pte points at a shared text frame
+#define COW_FLAG 0x400		//available bit: read-only until written, then copied
+#define CR0_WP 0x10000		//supervisor writes honour read-only pages
+#define CR4_PGE 0x80		//global pages survive a cr3 load
+#define CPUID_PGE 0x2000	//edx bit 13 of cpuid leaf 1
 
+#define PAGE_SIZE_4KB 0x1000
+#define PAGE_ADDR_MASK 0xFFFFF000
+
+/*user programs live in the 4MB window at 128MB, mapped with 4KB pages*/
+#define USER_VMEM_START 0x8000000
+#define USER_VMEM_END 0x8400000
+#define USER_PDE_INDEX 32
+#define KERNEL_PDE_END USER_PDE_INDEX	//entries below the window are the kernel's, the same in every directory
+/*the stack may grow down this far from the top of the window; the heap from
+  sbrk may grow up to where it starts*/
+#define USER_STACK_MAX 0x100000
+#define USER_HEAP_END (USER_VMEM_END - USER_STACK_MAX)
+/*read-only file mappings from mmap live in the 4MB window at 136MB*/
+#define MMAP_VMEM_START 0x8800000
+#define MMAP_VMEM_END 0x8C00000
+#define MMAP_PDE_INDEX 34
+/*4KB frames holding read-only program text shared between processes, one 4MB
+  block taken from the frame pool at boot*/
+#define SHARED_PAGE_MAX 1024
+#define SHARED_HASH_SIZE 256
+#define SHARED_NONE -1
+
+/*one shared text frame, keyed by the inode and page of the image it holds*/
+typedef struct shared_page_t{
+	uint32_t inode;
+	uint32_t page_idx;
+	uint32_t ref_count;
+	uint32_t in_use;
+	int32_t next;		//next entry in the same hash chain
+} shared_page_t;
+
+#define VIDEO 0xB8000		//vga text memory
+#define VIDMAP_PDE_INDEX 33	//user mapping of video memory from vidmap, at 132MB
 #define VIDEO_MEM_OFFSET 184
 #define KERNEL_loc 0x00400183 //400000 (4194304) -1 ([0]) + VIDEO_MEM
 
-void paging_init();
+void paging_init(multiboot_info_t* mbi);
 int32_t new_process_init(uint32_t process_num);
 extern uint32_t process_number;
 extern int32_t restore_paging(uint32_t proc_num);
-extern int32_t _4kb_video_page();
+extern int32_t _4kb_video_page(uint32_t process_num, uint32_t terminal_no, uint32_t addr);
+extern void map_video_mem(uint32_t addr);
+extern void remap_vidmem(uint32_t terminal_no, uint32_t addr);
+extern int32_t map_user_page(uint32_t process_num, uint32_t vaddr);
+extern int32_t map_shared_page(uint32_t process_num, uint32_t vaddr, uint32_t inode, uint32_t page_idx);
+extern uint32_t user_page_frame(uint32_t process_num, uint32_t vaddr);
+extern int32_t fork_user_pages(uint32_t parent, uint32_t child);
+extern int32_t cow_fault(uint32_t process_num, uint32_t vaddr);
+extern void unmap_user_pages(uint32_t process_num, uint32_t start, uint32_t end);
+extern void release_user_pages(uint32_t process_num);
+extern int32_t mmap_reserve(uint32_t process_num, uint32_t npages);
+extern int32_t map_file_page(uint32_t process_num, uint32_t vaddr, uint32_t paddr);
 
-extern void disable_vidmem(uint32_t PID, unsigned char *video_buffer, uint32_t terminal_no);
-extern void enable_vidmem(uint32_t PID, uint32_t terminal_no);
 #endif
@@ -2,6 +2,10 @@
 #include "filesys.h"
 #include "rtc.h"
 #include "terminal.h"
+#include "slab.h"
+
+/*pcbs of user processes*/
+static kmem_cache_t pcb_cache;
 
 /*fuction prototype for default read function*/
 int32_t nofunction1(int32_t fd, void* buf, int32_t nbytes) 
@@ -27,13 +31,83 @@ int32_t nofunction4(int32_t fd)
 	return -1;
 }
 
+/*fuction prototype for default seek function*/
+int32_t nofunction5(int32_t fd, int32_t offset, int32_t whence)
+{
+	return -1;
+}
+
+/*fuction prototype for default positioned read function*/
+int32_t nofunction6(int32_t fd, void* buf, int32_t nbytes, uint32_t offset)
+{
+	return -1;
+}
+
+/*fuction prototype for default stat function*/
+int32_t nofunction7(int32_t fd, stat_t* st)
+{
+	return -1;
+}
+
 /*function ops table*/
-fops_t rtc_fops = {rtc_open, rtc_read, rtc_write, rtc_close};
-fops_t file_fops = {file_open, file_read, file_write, file_close};
-fops_t stdin = {terminal_open, terminal_read, nofunction2, terminal_close};
-fops_t stdout = {terminal_open, nofunction1, terminal_write, terminal_close};
-fops_t directory_fops = {directory_open, directory_read, directory_write, directory_close};
-fops_t no_file = {nofunction3, nofunction1, nofunction2, nofunction4};
+fops_t rtc_fops = {rtc_open, rtc_read, rtc_write, rtc_close, nofunction5, nofunction6, nofunction7};
+fops_t file_fops = {file_open, file_read, file_write, file_close, file_seek, file_pread, file_stat};
+fops_t stdin = {terminal_open, terminal_read, nofunction2, terminal_close, nofunction5, nofunction6, nofunction7};
+fops_t stdout = {terminal_open, nofunction1, terminal_write, terminal_close, nofunction5, nofunction6, nofunction7};
+fops_t directory_fops = {directory_open, directory_read, directory_write, directory_close, nofunction5, nofunction6, directory_stat};
+fops_t no_file = {nofunction3, nofunction1, nofunction2, nofunction4, nofunction5, nofunction6, nofunction7};
+
+/*
+Constructor for pcbs in the slab cache
+Inputs: the new pcb
+Outputs: none
+Side effect: the pcb is zeroed, with empty rtc wait queues and an idle sleep timer,
+			 the state halt leaves it in
+*/
+static void pcb_ctor(void* obj)
+{
+	pcb* p = (pcb*)obj;
+	int i;
+
+	memset(p, 0, sizeof(pcb));
+	for(i = 0; i < 8; i++){
+		wait_queue_init(&p->file_array[i].rtc_wq);
+	}
+	timer_setup(&p->sleep_timer, NULL, 0);
+}
+
+/*
+Sets up the pcb cache
+Inputs: none
+Outputs: none
+Side effect: pcbs can be allocated once the frame pool is up
+*/
+void pcb_cache_init()
+{
+	kmem_cache_init(&pcb_cache, (const int8_t*)"pcb", sizeof(pcb), pcb_ctor);
+}
+
+/*
+Allocates a pcb
+Inputs: none
+Outputs: the pcb, NULL if out of memory
+Side effect: none; init_pcb fills it in
+*/
+pcb* pcb_alloc()
+{
+	return (pcb*)kmem_cache_alloc(&pcb_cache);
+}
+
+/*
+Frees a pcb
+Inputs: a pcb from pcb_alloc whose process has halted
+Outputs: none
+Side effect: the pcb goes back to the cache
+*/
+void pcb_free(pcb* p)
+{
+	kmem_cache_free(&pcb_cache, p);
+}
 
 /*
 Initializes pcb
@@ -53,6 +127,18 @@ int32_t init_pcb(pcb* parent_pcb, pcb* pcb_addr)
 	/*initialize number of opened files*/
 	cur_pcb->files_opened = 2;
 	cur_pcb->pcb_in_use = 1;
+	cur_pcb->forked = 0;
+	cur_pcb->state = PROC_RUNNING;
+	cur_pcb->wait_next = NULL;
+	cur_pcb->level = 0;
+	cur_pcb->ticks_left = 0;
+	cur_pcb->rt_period = 0;
+	cur_pcb->rt_budget = 0;
+	cur_pcb->rt_util = 0;
+	cur_pcb->rt_left = 0;
+	cur_pcb->rt_deadline = 0;
+	cur_pcb->rt_queued = 0;
+	timer_setup(&cur_pcb->sleep_timer, NULL, 0);
 
 	/*initialize parent pcb*/
 	cur_pcb->parent_pcb_ptr = parent_pcb;
@@ -78,6 +164,45 @@ int32_t init_pcb(pcb* parent_pcb, pcb* pcb_addr)
 	
 }
 
+/*
+Fills in the pcb of a child made by fork
+Inputs: the forking pcb, the child's pcb from pcb_alloc
+Outputs: 0 on completion
+Side effect: the child gets a copy of the parent's open files, with their own
+			 positions, and of its program image and break. Rtc descriptors are
+			 not inherited, since each one is linked into the rtc's list
+*/
+int32_t pcb_fork(pcb* parent, pcb* child)
+{
+	int i;
+
+	memcpy(child, parent, sizeof(pcb));
+	child->parent_pcb_ptr = NULL;
+	child->forked = 1;
+	child->halt_status = -1;
+	child->pcb_in_use = 1;
+	child->state = PROC_RUNNING;
+	child->wait_next = NULL;
+	child->rt_period = 0;
+	child->rt_budget = 0;
+	child->rt_util = 0;
+	child->rt_left = 0;
+	child->rt_deadline = 0;
+	child->rt_queued = 0;
+	timer_setup(&child->sleep_timer, NULL, 0);
+
+	for(i = 0; i < 8; i++){
+		wait_queue_init(&child->file_array[i].rtc_wq);
+		child->file_array[i].rtc_pending = 0;
+		child->file_array[i].rtc_next = NULL;
+		if(child->file_array[i].file_in_use && child->file_array[i].f_ops == &rtc_fops){
+			child->file_array[i].file_in_use = 0;
+			child->files_opened--;
+		}
+	}
+	return 0;
+}
+
 /*
 Adds an entry to the file array
 Inputs: pcb idx to add rtc to, NA, ptr to the pcb
@@ -205,6 +330,8 @@ int32_t pcb_close_file(uint32_t idx, pcb* cur_pcb)
 		return -1;
 	/*file is open, close file*/
 	else if (cur_pcb->file_array[idx].file_in_use){
+		if (cur_pcb->file_array[idx].f_ops == &rtc_fops)
+			rtc_release(&cur_pcb->file_array[idx]);
 		cur_pcb->file_array[idx].file_in_use = 0;
 		cur_pcb->files_opened--;
 		return 0;
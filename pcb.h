@@ -3,18 +3,41 @@
 
 #include "types.h"
 #include "lib.h"
+#include "waitqueue.h"
+#include "timer.h"
 
 typedef int32_t (*open_) (const uint8_t* filename);
 typedef int32_t (*read_) (int32_t fd, void* buf, int32_t nbytes);
 typedef int32_t (*write_) (int32_t fd, const void* buf, int32_t nbytes);
 typedef int32_t (*close_) (int32_t fd);
 
+/*whence values for lseek*/
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+/*what fstat reports about an open file*/
+typedef struct stat_t{
+	/*file type as in the directory entry*/
+	uint32_t type;
+	uint32_t inode;
+	/*size in bytes*/
+	uint32_t length;
+}stat_t;
+
+typedef int32_t (*seek_) (int32_t fd, int32_t offset, int32_t whence);
+typedef int32_t (*pread_) (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+typedef int32_t (*stat_) (int32_t fd, stat_t* st);
+
 /*f_ops prototype*/
 typedef struct fops_t{
 	open_ f_open;
 	read_ f_read;
 	write_ f_write;
 	close_ f_close; 
+	seek_ f_seek;
+	pread_ f_pread;
+	stat_ f_stat;
 }fops_t;
 
 /*file desciptor for file array*/
@@ -30,6 +53,15 @@ typedef struct file_desc
 	uint32_t file_in_use;
 	/*flag for is file array is populated with files*/
 	uint32_t no_file;
+	/*rtc only: interrupts per tick at the requested rate, interrupts left
+	  until the next tick, ticks not yet seen by rtc_read*/
+	uint32_t rtc_div;
+	uint32_t rtc_count;
+	volatile uint32_t rtc_pending;
+	/*rtc only: the reader sleeping for the next tick*/
+	wait_queue_t rtc_wq;
+	/*rtc only: next open rtc descriptor*/
+	struct file_desc* rtc_next;
 }file_desc;
 /*
 typedef struct term_struct
@@ -42,6 +74,10 @@ typedef struct term_struct
 
 }term_struct;*/
     
+/*scheduling state of a process*/
+#define PROC_RUNNING 0
+#define PROC_SLEEPING 1
+
 /*structure of pcb*/
 typedef struct pcb
 {	
@@ -57,6 +93,8 @@ typedef struct pcb
 	/*no of files opened in the file array*/
 	uint32_t files_opened;
 	int pcb_in_use;
+	/*1 if made by fork; nothing waits for it and halt just ends it*/
+	uint32_t forked;
 	//the terminal the current process is running on
 	
 	uint32_t halt_status;
@@ -64,10 +102,39 @@ typedef struct pcb
 	uint32_t esp;
 	uint32_t ebp;
 	uint32_t ps_cr3;
+	/*kernel stack pointer saved by switch_context while another process runs*/
 	uint32_t ps_esp;
 	uint32_t ps_ebp;
 
 	uint32_t term_pcb_idx;
+	/*terminal the process reads from and draws on*/
+	uint32_t terminal;
+
+	/*PROC_RUNNING, or PROC_SLEEPING while on a wait queue*/
+	volatile uint32_t state;
+	/*next process on the same wait queue*/
+	struct pcb* wait_next;
+	/*scheduler level, 0 is the highest, and ticks left in the current turn*/
+	uint32_t level;
+	uint32_t ticks_left;
+	/*real-time class: period and budget in microseconds, 0 budget for none*/
+	uint32_t rt_period;
+	uint32_t rt_budget;
+	uint32_t rt_util;		//budget/period in thousandths
+	int32_t rt_left;		//budget left in this period
+	uint32_t rt_deadline;	//end of this period in scheduler time
+	uint32_t rt_queued;		//1 while in the deadline queue
+	/*nanosleep: wakes the process from the timer wheel*/
+	ktimer_t sleep_timer;
+
+	/*program image, loaded into the window a page at a time on fault*/
+	uint32_t img_inode;
+	uint32_t img_size;
+	/*bytes at the start of the image that are read-only text, shared between processes*/
+	uint32_t img_text_end;
+	/*program break: the heap runs from brk_start, past the image's bss, up to brk*/
+	uint32_t brk_start;
+	uint32_t brk;
 
 	uint8_t cmd [32];
 	uint8_t args [128];
@@ -75,9 +142,22 @@ typedef struct pcb
   	uint8_t arg_size;
 }pcb;
 
+/*file operations of regular files and directories*/
+extern fops_t rtc_fops;
+extern fops_t file_fops;
+extern fops_t directory_fops;
+
+/*slab cache of user process pcbs*/
+extern void pcb_cache_init();
+extern pcb* pcb_alloc();
+extern void pcb_free(pcb* p);
+
 /*initializes pcb for a new process*/
 extern int32_t init_pcb(pcb* parent_pcb, pcb* pcb_addr);
 
+/*fills in the pcb of a child made by fork*/
+extern int32_t pcb_fork(pcb* parent, pcb* child);
+
 /*add a new file to the pcb's file array*/
 extern int32_t add_pcb_file(pcb* cur_pcb, uint32_t inode_ptr, int32_t type);
 
@@ -1,7 +1,12 @@
 #include "rtc.h"
 #include "lib.h"
+#include "schedule.h"
 #include "types.h"
 #include "rtc.h"
+#include "syscalls.h"
+
+/*open rtc descriptors of every process, linked through rtc_next*/
+static file_desc* rtc_list;
 
 /*
 rtc_init - initialize the RTC and enable it 
@@ -16,7 +21,7 @@ void rtc_init() {
 	char temp = inb(RTC_PORT_2); 				//store prev 0x71 port value
 	outb(DISABLE_NMI + REGISTER_B, RTC_PORT_1);	//set index to a again
 	outb(temp | 0x40, RTC_PORT_2);				//turn on bit 6 of reg B
-	enable_irq(RTC_IRQ);						//enable IRQ 8 on pic	
+	rtc_list = NULL;							//no descriptors open yet; irq 8 stays masked until one is
 	sti();										//restore ints
 }
 /*
@@ -32,14 +37,30 @@ void rtc_int_enable(){
 /*
 rtc_open - opens the RTC
 input: none
-output: none
-effect: open the rtc and set the default frequency to 2hz, add to the pcb
+output: the new descriptor, -1 on fail
+effect: adds the rtc to the pcb at 2hz and starts delivering it ticks. The hardware
+		rate is not touched, so other descriptors keep theirs
 */
 int32_t rtc_open(const uint8_t* filename){
-	sti();						//allow interrupts
-	enable_irq(RTC_IRQ);		//enable rtc 
-	rtc_set_frequency(15);		//set it to 2 hz
-	return add_pcb_file(curr_pcb, 0, 0); //add it to PCB
+	uint32_t flags;
+	file_desc* desc;
+	int32_t fd = add_pcb_file(curr_pcb, 0, 0); //add it to PCB
+	if(fd < 0)
+		return -1;
+
+	desc = &curr_pcb->file_array[fd];
+	desc->rtc_div = RTC_MAX_FREQ / RTC_DEFAULT_FREQ;
+	desc->rtc_count = desc->rtc_div;
+	desc->rtc_pending = 0;
+	wait_queue_init(&desc->rtc_wq);
+
+	cli_and_save(flags);
+	desc->rtc_next = rtc_list;
+	if(rtc_list == NULL)
+		enable_irq(RTC_IRQ);	//first user, start the interrupts
+	rtc_list = desc;
+	restore_flags(flags);
+	return fd;
 }
 
 
@@ -53,18 +74,44 @@ int32_t rtc_close(int32_t fd){
 	return 0;
 }
 
+/*
+rtc_release - stops delivering ticks to a descriptor
+input: desc - an open rtc descriptor
+output: none
+effect: called by pcb_close_file; masks the rtc irq once nobody has it open
+*/
+void rtc_release(file_desc* desc){
+	uint32_t flags;
+	file_desc** link;
+
+	cli_and_save(flags);
+	for(link = &rtc_list; *link != NULL; link = &(*link)->rtc_next){
+		if(*link == desc){
+			*link = desc->rtc_next;
+			break;
+		}
+	}
+	desc->rtc_next = NULL;
+	if(rtc_list == NULL)
+		disable_irq(RTC_IRQ);
+	restore_flags(flags);
+}
+
 /*
 rtc_read - read the RTC
 input: fd, buf - the buffer to use, nbytes - number of bytes to read
 output: return 0 on success
-effect: wait for next interrupt using a wait flag and while loop
+effect: sleeps on the descriptor's wait queue until its next tick. Ticks that
+		came while the process was busy are consumed together
 */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
-	sti();						//enable interrupts
-	rtc_wait = 1;				//set flag
-	while(rtc_wait);			//wait for interrupt
-	
-	//printf("RTC_READ WORKS\n");
+	file_desc* desc = &curr_pcb->file_array[fd];
+	uint32_t flags;
+
+	wait_event(desc->rtc_wq, desc->rtc_pending != 0);	//sleep until the handler counts a tick
+	cli_and_save(flags);
+	desc->rtc_pending = 0;
+	restore_flags(flags);
 	return 0;					//return after it has occurred
 }
 
@@ -72,48 +119,26 @@ int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
 rtc_write - writes the frequency to the RTC
 input: fd, buf - the buffer to use, nbytes - number of bytes to write
 output: number of bytes able to be written, number of written bytes on success. -1 on fail
-effect: change frequency depending on input
+effect: changes this descriptor's frequency only; the hardware stays at RTC_MAX_FREQ
 */
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes){
 	int* buf_temp = (int*)buf;
+	file_desc* desc = &curr_pcb->file_array[fd];
+	uint32_t flags;
 	
-	
-	if(nbytes != 4 || buf_temp[0] > 1024)	//check if more than 1024 hertz (our limit) or if they want to write more than four bytes
+	if(nbytes != 4 || buf_temp[0] > RTC_MAX_FREQ)	//check if more than 1024 hertz (our limit) or if they want to write more than four bytes
 		return -1;							//return fail
 
-	int rate;	
-	switch(buf_temp[0]){					//get the rate from the input hertz
-		case 2: rate = 15;					//2 hertz = rate 15
-				break;
-		case 4: rate = 14;					//4 hertz
-				break;
-		case 8: rate = 13;					//8
-				break;
-		case 16: rate = 12;					//etc...
-				break;
-		case 32: rate = 11;
-				break;
-		case 64: rate = 10;
-				break;
-		case 128: rate = 9;
-				break;
-		case 256: rate = 8;
-				break;
-		case 512: rate = 7;
-				break;
-		case 1024: rate = 6;				//this is the max in our kernel, though i have written the rest possible for the rtc
-				break;
-		case 2048: rate = 5;
-				break;
-		case 4096: rate = 4;
-				break;
-		case 8192: rate = 3;				//max of rtc is 8192 hz		
-				break;
-		default: printf("%d is an invalid RTC Frequency\n", buf_temp[0]);	//else it is an invalid frequency
-				return -1;
+	//any power of two from 2 to 1024 hertz
+	if(buf_temp[0] < 2 || (buf_temp[0] & (buf_temp[0] - 1)) != 0){
+		printf("%d is an invalid RTC Frequency\n", buf_temp[0]);	//else it is an invalid frequency
+		return -1;
 	}
-	//printf("rtc being changed to: %d hertz\n", buf_temp[0]);
-	rtc_set_frequency(rate);
+
+	cli_and_save(flags);
+	desc->rtc_div = RTC_MAX_FREQ / buf_temp[0];
+	desc->rtc_count = desc->rtc_div;	//start a fresh period
+	restore_flags(flags);
 	return 4;
 }
 
@@ -139,13 +164,25 @@ void rtc_set_frequency(int rate) {				//sets frequency as: freq = 32768 >> (rate
 rtc_handler - handles the rtc interrupts, sends eoi
 input: none
 output: none
-effect: assembly linked handler for rtc interrupts. activates when an rtc interrupt occurs, clears wait flag
+effect: assembly linked handler for rtc interrupts. counts down every open descriptor and wakes only
+		the readers whose tick is due. Each tick starts a new period for a real-time reader
 */
 void rtc_handler() {
+	file_desc* desc;
+	pcb* p;
 	//test_interrupts();							//test the interrupts
 	outb(REGISTER_C, RTC_PORT_1);				//select register c
 	inb(RTC_PORT_2);							//which interrupt happens. discard since we don't care :)
 	send_eoi(RTC_IRQ);							//send the EOI
-	rtc_wait = 0;
+	for(desc = rtc_list; desc != NULL; desc = desc->rtc_next){
+		if(--desc->rtc_count != 0)
+			continue;
+		desc->rtc_count = desc->rtc_div;
+		desc->rtc_pending++;
+		for(p = desc->rtc_wq.head; p != NULL; p = p->wait_next)
+			sched_rt_release(p);
+		wake_up(&desc->rtc_wq);					//let rtc_read return
+	}
+	sched_preempt();							//and run it if it outranks the current process
 }
 
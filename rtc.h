@@ -5,6 +5,7 @@
 #include "i8259.h"
 #include "idt_asm.h"
 #include "x86_desc.h"
+#include "pcb.h"
 
 #define RTC_PORT_1 0x70
 #define RTC_PORT_2 0x71
@@ -17,7 +18,11 @@
 #define RTC_IRQ 8
 #define RTC_INT_VEC 40
 
-volatile uint8_t rtc_wait;		//wait flag for rtc read
+/*the hardware always runs at the fastest rate a descriptor may ask for;
+  each descriptor divides it down to its own rate*/
+#define RTC_MAX_FREQ 1024
+#define RTC_MAX_RATE 6			//rate bits for 1024 hz
+#define RTC_DEFAULT_FREQ 2		//rate of a newly opened descriptor
 
 /*rtc_initialization function*/
 extern void rtc_init();
@@ -33,6 +38,8 @@ extern int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
 extern int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
 /*sets the frequency of the rtc*/
 extern void rtc_set_frequency(int rate);
+/*stops delivering ticks to a descriptor being closed*/
+extern void rtc_release(file_desc* desc);
 /*idt handler for rtc interrupts*/
 extern void rtc_handler();
 
@@ -1,9 +1,51 @@
 #include "schedule.h"
 #include "lib.h"
 #include "types.h"
+#include "paging.h"
+#include "syscalls_asm.h"
+#include "syscall_linker.h"
+#include "clock.h"
+#include "timer.h"
 
-pcb_linked_t* pcb_linked_list;
-pcb_linked_t* pcb_list_storage[6];
+/*run queues, one per priority level: circular lists whose head runs next*/
+static pcb_linked_t* run_queue[SCHED_LEVELS];
+/*real-time processes with budget left, earliest deadline at the head; runs before all levels*/
+static pcb_linked_t* rt_queue;
+/*one node per pid, plus one per terminal boot context*/
+static pcb_linked_t pcb_list_storage[PROCESS_MAX + TERMINAL_MAX];
+
+/*boot contexts, one per terminal, each runs terminal_boot on its own stack*/
+static pcb boot_pcb[TERMINAL_MAX];
+static uint32_t boot_stack[TERMINAL_MAX][BOOT_STACK_SIZE / 4];
+
+/*1 once sched_start has switched to the first terminal*/
+static uint32_t sched_running;
+/*1 while schedule waits in hlt for something to become runnable*/
+static uint32_t sched_idle;
+/*1 when a tick or a wakeup wants schedule to run before returning to the process*/
+static uint32_t need_resched;
+
+/*timing, set at boot by sched_configure*/
+static uint32_t sched_hz = SCHED_HZ;
+static uint32_t quantum[SCHED_LEVELS];	//ticks per turn at each level
+static uint32_t boost_ticks;			//ticks between priority boosts
+static ktimer_t boost_timer;
+static uint32_t tick_us;				//length of a tick in microseconds
+
+/*processes on the run queues*/
+static uint32_t nr_running;
+/*tickless: 1 while the PIT is in one-shot mode, and the time the wheel has been
+  brought up to*/
+static uint32_t tick_nohz;
+static uint64_t nohz_last_ns;
+/*tick the programmed one-shot lands on*/
+static uint32_t nohz_shot;
+
+/*sum of budget/period over admitted real-time processes, in thousandths*/
+static uint32_t rt_util;
+
+static void sched_boost_timeout(uint32_t data);
+static void sched_nohz_exit();
 
 /*
 init_scheduler - function that starts scheduling for the kernel
@@ -13,100 +55,728 @@ effect: runs functions that sets up the scheduling
 
 */
 void init_scheduler(){
+	if(quantum[0] == 0)
+		sched_configure(SCHED_HZ, SCHED_QUANTUM_MS);
+	timer_init(tick_us * 1000);
+	timer_setup(&boost_timer, sched_boost_timeout, 0);
+	timer_add(&boost_timer, timer_jiffies + boost_ticks);
 	pit_int_enable();
 	init_pit();
 }
 
 /*
-add_pcb_to_list - adds a pcb to a circular linked list for scheduling
+sched_configure - sets the tick rate and quantum
+input: hz - PIT interrupts per second, quantum_ms - length of a turn at the top level
+output: none
+effect: each level below the top gets twice the quantum of the one above it.
+		Out of range values fall back to the defaults
+*/
+void sched_configure(uint32_t hz, uint32_t quantum_ms){
+	uint32_t i, ticks;
+
+	if(hz < SCHED_HZ_MIN || hz > SCHED_HZ_MAX)
+		hz = SCHED_HZ;
+	if(quantum_ms == 0 || quantum_ms > SCHED_QUANTUM_MS_MAX)
+		quantum_ms = SCHED_QUANTUM_MS;
+	sched_hz = hz;
+
+	ticks = quantum_ms * hz / 1000;
+	if(ticks == 0)
+		ticks = 1;
+	for(i = 0; i < SCHED_LEVELS; i++)
+		quantum[i] = ticks << i;
+	boost_ticks = SCHED_BOOST_MS * hz / 1000;
+	tick_us = 1000000 / hz;
+}
+
+/*
+sched_parse_number - reads the decimal number after "name=" in the boot command line
+input: cmdline - the command line, name - the option with its '='
+output: the number, 0 if the option is missing
+effect: none
+*/
+static uint32_t sched_parse_number(const int8_t* cmdline, const int8_t* name){
+	uint32_t len = strlen(name);
+	uint32_t value = 0;
+	const int8_t* p;
+
+	for(p = cmdline; *p != '\0'; p++){
+		if((p == cmdline || p[-1] == ' ') && strncmp(p, name, len) == 0){
+			for(p += len; *p >= '0' && *p <= '9'; p++)
+				value = value * 10 + (*p - '0');
+			return value;
+		}
+	}
+	return 0;
+}
+
+/*
+sched_parse_cmdline - picks the tick rate and quantum from the boot command line
+input: cmdline - e.g. "sched_hz=100 sched_quantum=10", or NULL
+output: none
+effect: calls sched_configure; missing options keep their defaults
+*/
+void sched_parse_cmdline(const int8_t* cmdline){
+	uint32_t hz = SCHED_HZ;
+	uint32_t quantum_ms = SCHED_QUANTUM_MS;
+
+	if(cmdline != NULL){
+		hz = sched_parse_number(cmdline, (int8_t*)"sched_hz=");
+		quantum_ms = sched_parse_number(cmdline, (int8_t*)"sched_quantum=");
+	}
+	sched_configure(hz, quantum_ms);
+}
+
+/*
+run_queue_push - appends a node to the tail of a queue
+input: queue - the queue's head pointer, node - an unqueued node
+output: none
+effect: the node runs after everything already in the queue
+*/
+static void run_queue_push(pcb_linked_t** queue, pcb_linked_t* node){
+	pcb_linked_t* head = *queue;
+	if(head == NULL){
+		node->next = node;
+		node->prev = node;
+		*queue = node;
+		return;
+	}
+	node->next = head;
+	node->prev = head->prev;
+	head->prev->next = node;
+	head->prev = node;
+}
+
+/*
+run_queue_unlink - takes a node out of a queue
+input: queue - the queue's head pointer, node - a node in that queue
+output: none
+effect: keeps the list circular; the next node becomes head if node was
+*/
+static void run_queue_unlink(pcb_linked_t** queue, pcb_linked_t* node){
+	if(node->next == node){
+		*queue = NULL;
+	}
+	else{
+		node->prev->next = node->next;
+		node->next->prev = node->prev;
+		if(*queue == node)
+			*queue = node->next;
+	}
+	node->next = NULL;
+	node->prev = NULL;
+}
+
+/*
+deadline_before - compares two deadlines
+input: a, b - deadlines in microseconds of scheduler time
+output: 1 if a comes before b, 0 otherwise
+effect: correct across the wrap of the 32 bit clock
+*/
+static int32_t deadline_before(uint32_t a, uint32_t b){
+	return (int32_t)(a - b) < 0;
+}
+
+/*
+rt_queue_insert - queues a real-time process in deadline order
+input: node - an unqueued node whose pcb has budget left
+output: none
+effect: node goes after every process with the same or an earlier deadline
+*/
+static void rt_queue_insert(pcb_linked_t* node){
+	pcb_linked_t* head = rt_queue;
+	pcb_linked_t* pos = head;
+
+	if(head == NULL){
+		run_queue_push(&rt_queue, node);
+		return;
+	}
+	do{
+		if(deadline_before(node->pcb->rt_deadline, pos->pcb->rt_deadline))
+			break;
+		pos = pos->next;
+	}while(pos != head);
+
+	node->next = pos;
+	node->prev = pos->prev;
+	pos->prev->next = node;
+	pos->prev = node;
+	if(pos == head && deadline_before(node->pcb->rt_deadline, head->pcb->rt_deadline))
+		rt_queue = node;
+}
+
+/*
+sched_outranks - whether a process should preempt the running one
+input: target - a process that just became runnable
+output: 1 if target should run before curr_pcb, 0 otherwise
+effect: none
+*/
+static int32_t sched_outranks(pcb* target){
+	if(curr_pcb == NULL || curr_pcb == target)
+		return 0;
+	if(target->rt_queued)
+		return !curr_pcb->rt_queued || deadline_before(target->rt_deadline, curr_pcb->rt_deadline);
+	return !curr_pcb->rt_queued && target->level < curr_pcb->level;
+}
+
+/*
+run_queue_add - adds a pcb to the run queue
 input: target - the pcb to add
 output: none
-effect: inserts the target pcb to head of the list, updating the other nodes to keep it circular
+effect: a real-time process with budget left goes into the deadline queue, anything
+		else at the tail of its level, so it runs after everything already queued
+		there. Does nothing if target is already queued
+*/
+void run_queue_add(pcb* target){
+	pcb_linked_t* new_node = &pcb_list_storage[target->pid];
+	if(new_node->next != NULL)
+		return;
+	new_node->pcb = target;
+	nr_running++;
+	if(target->rt_budget != 0 && target->rt_left > 0){
+		target->rt_queued = 1;
+		rt_queue_insert(new_node);
+	}
+	else{
+		if(target->ticks_left == 0)
+			target->ticks_left = quantum[target->level];
+		run_queue_push(&run_queue[target->level], new_node);
+	}
+	//a process above the running one should not wait for the end of its turn
+	if(sched_outranks(target))
+		need_resched = 1;
+	//two processes now share the cpu, so they need the periodic tick again
+	if(tick_nohz && nr_running > 1)
+		sched_nohz_exit();
+}
+
+/*
+run_queue_remove - removes a pcb from the run queue
+input: target - the pcb to remove
+output: none
+effect: unlinks target from the queue of its level
 */
-void add_pcb_to_list(pcb* target){
-	pcb_linked_t* new_node = pcb_list_storage[target->pid];
+void run_queue_remove(pcb* target){
+	pcb_linked_t* curr_node = &pcb_list_storage[target->pid];
+	if(curr_node->next == NULL)
+		return;
+	nr_running--;
+	if(target->rt_queued){
+		target->rt_queued = 0;
+		run_queue_unlink(&rt_queue, curr_node);
+	}
+	else{
+		run_queue_unlink(&run_queue[target->level], curr_node);
+	}
+}
+
+/*
+run_queue_replace - puts one pcb in the place of another in the run queue
+input: old - the pcb leaving, target - the pcb taking its place
+output: none
+effect: used when a process execs a child or halts back to its parent, so the
+		terminal keeps its turn, level and place in the rotation
+*/
+void run_queue_replace(pcb* old, pcb* target){
+	pcb_linked_t* old_node = &pcb_list_storage[old->pid];
+	pcb_linked_t* new_node = &pcb_list_storage[target->pid];
+	uint32_t level = old->level;
+
+	target->level = level;
+	target->ticks_left = old->ticks_left;
+	if(old_node->next == NULL || old->rt_queued || target->rt_budget != 0){
+		//the deadline queue is ordered per process, so there is no slot to hand over
+		run_queue_remove(old);
+		run_queue_add(target);
+		return;
+	}
+	if(old_node == new_node){
+		new_node->pcb = target;
+		return;
+	}
+	if(old_node->next == old_node){
+		new_node->next = new_node;
+		new_node->prev = new_node;
+	}
+	else{
+		new_node->next = old_node->next;
+		new_node->prev = old_node->prev;
+		old_node->prev->next = new_node;
+		old_node->next->prev = new_node;
+	}
 	new_node->pcb = target;
-	new_node->next = pcb_linked_list;
-	new_node->prev = pcb_linked_list->prev;
-	pcb_linked_list = new_node;
+	if(run_queue[level] == old_node)
+		run_queue[level] = new_node;
+	old_node->next = NULL;
+	old_node->prev = NULL;
 }
 
 /*
-remove_pcb_from_list - removes a pcb from the linked list for scheduling
-input: pid - the id of the node to remove
+sched_wakeup - makes a process that slept runnable again
+input: target - the process being woken
 output: none
-effect: removes the pid from the linked list, update to keep circular
+effect: a process that blocked for input or the rtc goes back to the top level
+		with a fresh quantum, so interactive work runs ahead of cpu-bound jobs
 */
-void remove_pcb_from_list(uint32_t pid){
-	pcb_linked_t* curr_node = pcb_list_storage[pid];
-	if(pcb_linked_list == curr_node)
-		pcb_linked_list = curr_node->next;
-	pcb_linked_t* temp = curr_node->next;
-	temp->prev = curr_node->prev;
-	curr_node->prev->next = temp;
+void sched_wakeup(pcb* target){
+	target->state = PROC_RUNNING;
+	if(pcb_list_storage[target->pid].next == NULL){
+		target->level = 0;
+		target->ticks_left = quantum[0];
+	}
+	run_queue_add(target);
 }
+
 /*
-clear_pcb - clears the pcb entry from the list storage
-input: pid - id of the node to clear
+sched_boost - moves every queued process back to the top level
+input: none
 output: none
-effect: clears out the entry in the list array
+effect: runs every SCHED_BOOST_MS so demoted processes can't starve
 */
-void clear_pcb(uint32_t pid){
-	pcb_list_storage[pid]->pcb = NULL;
-	pcb_list_storage[pid]->next = NULL;
-	pcb_list_storage[pid]->prev = NULL;
+static void sched_boost(){
+	uint32_t level;
+	pcb_linked_t* node;
+
+	for(level = 1; level < SCHED_LEVELS; level++){
+		while(run_queue[level] != NULL){
+			node = run_queue[level];
+			run_queue_unlink(&run_queue[level], node);
+			node->pcb->level = 0;
+			node->pcb->ticks_left = quantum[0];
+			run_queue_push(&run_queue[0], node);
+		}
+	}
 }
 
 /*
-switch_process - switches the process for scheduling 
-input: 
+sched_boost_timeout - timer callback for the periodic boost
+input: data - unused
 output: none
-effect: 
+effect: boosts every process and arms itself for the next period
 */
-void switch_process(/*int32_t target, int32_t current*/){
+static void sched_boost_timeout(uint32_t data){
+	sched_boost();
+	need_resched = 1;
+	timer_add(&boost_timer, timer_jiffies + boost_ticks);
+}
 
-	if(!(pcb_linked_list->next)){	//check if there is something in the queue
-		return;						//return since nothing to switch to
+/*
+sched_pick - the process that should run now
+input: none
+output: the real-time process with the earliest deadline, else the head of the
+		highest non-empty level, NULL if nothing is runnable
+effect: none
+*/
+static pcb* sched_pick(){
+	uint32_t level;
+	if(rt_queue != NULL)
+		return rt_queue->pcb;
+	for(level = 0; level < SCHED_LEVELS; level++){
+		if(run_queue[level] != NULL)
+			return run_queue[level]->pcb;
 	}
-	pcb* curr_process_pcb = pcb_linked_list->pcb;		//get next pcb up for processing
-	pcb* prev_process_pcb = curr_process_pcb->parent_pcb_ptr;		//get parent of the next up process, aka the current running one
-	
-	pcb_linked_list = pcb_linked_list->next;			//rotate the linked list to go to next process in queue
-	
-	uint32_t esp, ebp;
-	asm volatile("movl %%esp, %0" : "=b"(esp));
-	asm volatile("movl %%ebp, %0" : "=b"(ebp));
-	
-	//save the previous process' progress into the esp and ebp entries in its pcb
-	prev_process_pcb->esp = esp;
-	prev_process_pcb->ebp = ebp;
-	
-	asm volatile("movl %0, %%esp" : : "a"(curr_process_pcb->esp));
-	asm volatile("movl %0, %%ebp" : : "a"(curr_process_pcb->ebp));
-	
-	//terminal_t* terminals = get_terminals();
-	
-	tss.ss0 = KERNEL_DS;
-	tss.esp0 = KERNEL_START - (curr_process_pcb->pid*EIGHT_KB)-FOUR;
-	
+	return NULL;
 }
 
 /*
-init_pit - initializes the PIT and sets it to 20ms interrupts
+sched_next - the process to switch to
 input: none
+output: the first runnable process
+effect: halts the cpu until an interrupt wakes a process up if nothing is runnable
+*/
+static pcb* sched_next(){
+	pcb* next;
+
+	sched_idle = 1;
+	while((next = sched_pick()) == NULL){
+		asm volatile ("sti; hlt; cli" : : : "memory");
+	}
+	sched_idle = 0;
+	return next;
+}
+
+/*
+switch_process - switches the cpu to another process
+input: save_esp - where to save the running process's stack pointer, next - the process to run
 output: none
-effect: enables the PIT irq, sets the control word, and sets a 20ms count for interrupts
+effect: loads next's terminal, page directory and kernel stack, then swaps the saved
+		register sets. Returns when something switches back to the saved stack
 */
-void init_pit(){
-	enable_irq(0);					//enable irq 0 for the PIT
-	uint32_t count = 1193180 / 50;	//send interrupt every 20ms, 1193180 is default count, divide to get a faster rate. We want 20 hz so we divide by 50 
-	uint8_t control_word = 0x34;	//create control word
-	
+static void switch_process(uint32_t* save_esp, pcb* next){
+	terminal_load(next->terminal);
+	if(next->pid < PROCESS_MAX){
+		restore_paging(next->pid);
+		tss.ss0 = KERNEL_DS;
+		tss.esp0 = kernel_stack_top(next->pid);
+	}
+	curr_pcb = next;
+	switch_context(save_esp, next->ps_esp);
+}
+
+/*
+schedule - picks the next process to run and switches to it
+input: none
+output: -1 if the scheduler is not running, 0 otherwise
+effect: called with interrupts off. A process that is no longer runnable is taken off
+		the run queue first. If nothing is runnable the cpu halts until an interrupt
+		wakes a process up
+*/
+int32_t schedule(){
+	pcb* prev = curr_pcb;
+	pcb* next;
+
+	if(!sched_running || sched_idle)
+		return -1;
+	need_resched = 0;
+
+	if(prev->state != PROC_RUNNING)
+		run_queue_remove(prev);
+
+	next = sched_next();
+	if(next != prev)
+		switch_process(&prev->ps_esp, next);
+	return 0;
+}
+
+/*
+sched_exit - leaves a process that has halted for good
+input: none
+output: none, never returns
+effect: called with interrupts off once the current process is off the run queue.
+		Its registers are not saved, so nothing can switch back to it
+*/
+void sched_exit(){
+	uint32_t unused_esp;
+
+	need_resched = 0;
+	switch_process(&unused_esp, sched_next());
+	while(1);
+}
+
+/*
+sched_fork - queues a process made by fork
+input: child - its pcb, frame - the copy of the parent's system call frame at the
+		top of the child's kernel stack
+output: none
+effect: the first switch to child returns into fork_child_ret, which finishes the
+		system call in user mode with 0 in eax
+*/
+void sched_fork(pcb* child, uint32_t* frame){
+	uint32_t* sp = frame;
+
+	//frame for switch_context to pop, as in sched_start
+	*(--sp) = (uint32_t)fork_child_ret;
+	*(--sp) = EFLAGS_RESERVED;		//iret restores the user's eflags
+	sp -= 8;						//pushal frame
+	memset(sp, 0, 8 * 4);
+	child->ps_esp = (uint32_t)sp;
+	child->ticks_left = 0;
+	run_queue_add(child);
+}
+
+/*
+sched_rt_setparam - moves a process into or out of the real-time class
+input: target - the process, period_us - its release period, budget_us - cpu time
+		it may use per period, 0 to leave the class
+output: 0 on success, -1 if the budget is larger than the period or admitting it
+		would take real-time use over SCHED_RT_UTIL_MAX
+effect: the first release happens on the next call to sched_rt_release
+*/
+int32_t sched_rt_setparam(pcb* target, uint32_t period_us, uint32_t budget_us){
+	uint32_t flags;
+	uint32_t util;
+
+	if(budget_us == 0){
+		sched_rt_clear(target);
+		return 0;
+	}
+	if(period_us == 0 || budget_us > period_us)
+		return -1;
+	util = budget_us * 1000 / period_us;
+	if(util == 0)
+		util = 1;
+
+	cli_and_save(flags);
+	if(rt_util - target->rt_util + util > SCHED_RT_UTIL_MAX){
+		restore_flags(flags);
+		return -1;
+	}
+	rt_util = rt_util - target->rt_util + util;
+	target->rt_util = util;
+	target->rt_period = period_us;
+	target->rt_budget = budget_us;
+	target->rt_left = 0;
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+sched_rt_clear - takes a process out of the real-time class
+input: target - the process
+output: none
+effect: gives its share back to admission control; it keeps running at its level
+*/
+void sched_rt_clear(pcb* target){
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(target->rt_budget != 0){
+		rt_util -= target->rt_util;
+		if(target->rt_queued){
+			run_queue_remove(target);
+			target->rt_budget = 0;
+			run_queue_add(target);
+		}
+	}
+	target->rt_budget = 0;
+	target->rt_period = 0;
+	target->rt_util = 0;
+	target->rt_left = 0;
+	restore_flags(flags);
+}
+
+/*
+sched_rt_release - starts a new period for a real-time process
+input: target - the process, about to be woken by its rtc interrupt
+output: none
+effect: refills the budget and sets the deadline one period from now
+*/
+void sched_rt_release(pcb* target){
+	if(target->rt_budget == 0)
+		return;
+	sched_nohz_sync();
+	target->rt_deadline = timer_jiffies * tick_us + target->rt_period;
+	target->rt_left = target->rt_budget;
+	if(pcb_list_storage[target->pid].next != NULL && !target->rt_queued){
+		//still runnable from a throttled period: move it up now
+		run_queue_remove(target);
+		run_queue_add(target);
+	}
+}
+
+/*
+sched_tick - charges the running process for one PIT tick
+input: none
+output: none
+effect: a process that uses up its quantum drops a level and goes to the back of
+		it. A real-time process that uses up its budget is throttled to its level
+		until its next release
+*/
+static void sched_tick(){
+	pcb* p = curr_pcb;
+	pcb_linked_t* node = &pcb_list_storage[p->pid];
+
+	if(node->next == NULL)
+		return;
+	if(p->rt_queued){
+		p->rt_left -= tick_us;
+		if(p->rt_left <= 0){
+			run_queue_remove(p);
+			run_queue_add(p);
+			need_resched = 1;
+		}
+		return;
+	}
+	if(p->ticks_left > 1){
+		p->ticks_left--;
+		return;
+	}
+	run_queue_unlink(&run_queue[p->level], node);
+	if(p->level < SCHED_LEVELS - 1)
+		p->level++;
+	p->ticks_left = quantum[p->level];
+	run_queue_push(&run_queue[p->level], node);
+	need_resched = 1;
+}
+
+/*
+sched_preempt - reschedules if a tick or wakeup asked for it
+input: none
+output: none
+effect: called at the end of interrupt handlers, with interrupts off
+*/
+void sched_preempt(){
+	if(need_resched)
+		schedule();
+}
+
+/*
+terminal_boot - first code run by a terminal's boot context
+input: none
+output: none
+effect: starts the terminal's shell, which takes over the boot context's turn
+*/
+static void terminal_boot(){
+	execute((uint8_t*)"shell");
+	//only reached if the shell could not be started
+	printf("could not start shell on terminal %d\n", curr_pcb->terminal);
+	curr_pcb->state = PROC_SLEEPING;
+	while(1)
+		schedule();
+}
+
+/*
+sched_start - starts a shell on every terminal and begins preemptive scheduling
+input: none
+output: none, never returns
+effect: queues one boot context per terminal and switches to the first one; the boot
+		stack of kernel.c is abandoned
+*/
+void sched_start(){
+	uint32_t t;
+	uint32_t* sp;
+	uint32_t unused_esp;
+
+	cli();
+	for(t = 0; t < TERMINAL_MAX; t++){
+		boot_pcb[t].pid = BOOT_PID(t);
+		boot_pcb[t].terminal = t;
+		boot_pcb[t].state = PROC_RUNNING;
+		boot_pcb[t].parent_pcb_ptr = NULL;
+		boot_pcb[t].level = 0;
+		boot_pcb[t].ticks_left = 0;
+
+		//frame for switch_context to pop: registers, eflags, then return into terminal_boot
+		sp = &boot_stack[t][BOOT_STACK_SIZE / 4];
+		*(--sp) = 0;					//terminal_boot's return address, never used
+		*(--sp) = (uint32_t)terminal_boot;
+		*(--sp) = EFLAGS_RESERVED;		//interrupts stay off until the shell irets
+		sp -= 8;						//pushal frame
+		memset(sp, 0, 8 * 4);
+		boot_pcb[t].ps_esp = (uint32_t)sp;
+		run_queue_add(&boot_pcb[t]);
+	}
+
+	sched_running = 1;
+	init_scheduler();
+	curr_pcb = &boot_pcb[0];
+	terminal_load(0);
+	switch_context(&unused_esp, boot_pcb[0].ps_esp);
+}
+
+/*
+pit_program - loads channel 0 of the PIT
+input: control_word - PIT_PERIODIC or PIT_ONESHOT, count - input clocks to the next interrupt
+output: none
+effect: the new count takes effect right away
+*/
+static void pit_program(uint8_t control_word, uint32_t count){
 	outb(control_word, PIT_PORT_1);	//send the control word to the PIT
 	
-	outb((uint8_t)(count & 0xf), PIT_PORT_2);	//send the LSB of the count to the PIT
+	outb((uint8_t)(count & 0xff), PIT_PORT_2);	//send the LSB of the count to the PIT
 	outb((uint8_t)(count >> 8), PIT_PORT_2);	//send the MSB of the count to the PIT
-	
+}
+
+/*
+init_pit - initializes the PIT at the tick rate picked at boot
+input: none
+output: none
+effect: enables the PIT irq, sets the control word, and sets the count for sched_hz interrupts
+*/
+void init_pit(){
+	enable_irq(0);					//enable irq 0 for the PIT
+	pit_program(PIT_PERIODIC, PIT_FREQ / sched_hz);	//count of input clocks between interrupts
+}
+
+/*
+sched_nohz_catchup - brings the timer wheel up to date after running tickless
+input: none
+output: none
+effect: runs the wheel once for every whole tick the tsc says has passed
+*/
+static void sched_nohz_catchup(){
+	uint64_t now = clock_now_ns();
+	uint64_t elapsed = now - nohz_last_ns;
+	uint32_t rem = div64_32(&elapsed, tick_us * 1000);
+
+	//moved before the timers run, so a wakeup that ends tickless mode from inside
+	//them finds nothing left to catch up
+	nohz_last_ns = now - rem;
+	if(elapsed != 0)
+		timer_run((uint32_t)elapsed);
+}
+
+/*
+sched_nohz_exit - goes back to the periodic tick
+input: none
+output: none
+effect: called with interrupts off when a second process becomes runnable
+*/
+static void sched_nohz_exit(){
+	tick_nohz = 0;
+	pit_program(PIT_PERIODIC, PIT_FREQ / sched_hz);
+	sched_nohz_catchup();
+}
+
+/*
+sched_nohz_program - arms the one-shot for a tick boundary
+input: ticks - whole ticks past the last boundary the wheel was brought up to
+output: none
+effect: the part of the current tick already gone comes off the count, so the
+		interrupt lands on the boundary rather than up to a tick after it. A
+		one-shot count tops out near 55ms, so long idle periods take a few shots
+*/
+static void sched_nohz_program(uint32_t ticks){
+	uint32_t per_tick = PIT_FREQ / sched_hz;
+	uint64_t part_ns = clock_now_ns() - nohz_last_ns;
+	uint32_t part = 0;
+
+	if((int32_t)ticks <= 0)
+		ticks = 1;		//already due, fire at the next boundary
+	if(ticks > PIT_MAX_COUNT / per_tick)
+		ticks = PIT_MAX_COUNT / per_tick;
+	if(part_ns < tick_us * 1000)
+		part = ((uint32_t)part_ns / 1000) * per_tick / tick_us;
+	nohz_shot = timer_jiffies + ticks;
+	pit_program(PIT_ONESHOT, ticks * per_tick - part);
+}
+
+/*
+sched_nohz_update - picks the tick mode after a PIT interrupt
+input: none
+output: none
+effect: with one process or none runnable there is nothing to preempt, so the PIT
+		is set to fire once at the next timer deadline instead of every tick
+*/
+static void sched_nohz_update(){
+	if(!sched_running || !clock_has_tsc() || nr_running > 1){
+		if(tick_nohz)
+			sched_nohz_exit();
+		return;
+	}
+	if(!tick_nohz){
+		tick_nohz = 1;
+		nohz_last_ns = clock_now_ns();	//this interrupt was a tick boundary
+	}
+	sched_nohz_program(timer_next_expiry() - timer_jiffies);
+}
+
+/*
+sched_nohz_sync - brings timer_jiffies up to date
+input: none
+output: none
+effect: tickless, the wheel only moves in PIT interrupts that may be far apart, so
+		code outside them calls this before reading timer_jiffies
+*/
+void sched_nohz_sync(){
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(tick_nohz)
+		sched_nohz_catchup();
+	restore_flags(flags);
+}
+
+/*
+sched_nohz_rearm - makes sure the one-shot comes in time for a new timer
+input: expires - tick the timer was armed for
+output: none
+effect: called by timer_add with interrupts off. A timer due before the programmed
+		interrupt moves it earlier
+*/
+void sched_nohz_rearm(uint32_t expires){
+	if(tick_nohz && (int32_t)(expires - nohz_shot) < 0)
+		sched_nohz_program(expires - timer_jiffies);
 }
 
 /*
@@ -121,13 +791,25 @@ void pit_int_enable(){
 
 /*
 pit_handler - function that determines what occurs during PIT interrupt
-				in our case it is doing a round robin scheduling switch
+				in our case it is charging the running process and rescheduling
 input: none
 output: none
-effect: switches the current process that is being computed, sends eoi
+effect: sends eoi first, since the switch may not come back here for a while,
+		then switches if the process used up its quantum or was outranked.
+		Tickless, the interrupt stands for however many ticks have passed
 */
 void pit_handler(){
-	//printf("p");
-	switch_process();
 	send_eoi(0);
+	if(tick_nohz){
+		sched_nohz_catchup();		//sleepers wake even while the cpu idles
+	}
+	else{
+		clock_tick(tick_us * 1000);
+		timer_run(1);
+	}
+	sched_nohz_update();
+	if(!sched_running || sched_idle)
+		return;
+	sched_tick();
+	sched_preempt();
 }
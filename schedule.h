@@ -6,9 +6,28 @@
 #include "idt_asm.h"
 #include "x86_desc.h"
 #include "terminal.h"
+#include "syscalls.h"
 
 #define PIT_PORT_1 0x43
 #define PIT_PORT_2 0x40
+#define PIT_FREQ 1193180	//input clock of the PIT in hz
+#define PIT_PERIODIC 0x34	//channel 0, lobyte/hibyte, mode 2 rate generator
+#define PIT_ONESHOT 0x30	//channel 0, lobyte/hibyte, mode 0 interrupt on terminal count
+#define PIT_MAX_COUNT 0xffff
+/*multi-level feedback queue; the defaults can be changed on the boot command line*/
+#define SCHED_LEVELS 3			//level 0 runs first; quantum doubles at each level down
+#define SCHED_HZ 100			//default ticks per second (sched_hz=)
+#define SCHED_HZ_MIN 19			//slowest rate the 16 bit PIT divisor allows
+#define SCHED_HZ_MAX 1000
+#define SCHED_QUANTUM_MS 10		//default quantum of level 0 (sched_quantum=)
+#define SCHED_QUANTUM_MS_MAX 1000
+#define SCHED_BOOST_MS 1000		//how often every process is moved back to level 0
+#define SCHED_RT_UTIL_MAX 900	//real-time budgets may use at most 90% of the cpu
+
+/*each terminal starts from a boot context that only lives to exec its shell*/
+#define BOOT_STACK_SIZE 4096
+#define BOOT_PID(t) (PROCESS_MAX + (t))
+#define EFLAGS_RESERVED 0x2	//bit 1 of eflags is always set
 
 typedef struct pcb_linked_t
 {
@@ -19,9 +38,24 @@ typedef struct pcb_linked_t
 
 
 extern void init_scheduler();
-void switch_process(/*int32_t target, int32_t current*/);
+extern void sched_configure(uint32_t hz, uint32_t quantum_ms);
+extern void sched_parse_cmdline(const int8_t* cmdline);
+extern void sched_wakeup(pcb* target);
+extern void sched_preempt();
+extern int32_t sched_rt_setparam(pcb* target, uint32_t period_us, uint32_t budget_us);
+extern void sched_rt_clear(pcb* target);
+extern void sched_rt_release(pcb* target);
+extern void sched_start();
+extern int32_t schedule();
+extern void sched_exit();
+extern void sched_fork(pcb* child, uint32_t* frame);
+extern void run_queue_add(pcb* target);
+extern void run_queue_remove(pcb* target);
+extern void run_queue_replace(pcb* old, pcb* target);
 extern void init_pit();
 extern void pit_int_enable();
 extern void pit_handler();
+extern void sched_nohz_sync();
+extern void sched_nohz_rearm(uint32_t expires);
 
 #endif
@@ -0,0 +1,164 @@
+#include "slab.h"
+#include "frame.h"
+#include "lib.h"
+
+/*the free list link of an object, stored right after it*/
+#define SLAB_LINK(cache, obj) (*(void**)((uint8_t*)(obj) + (cache)->obj_size))
+#define SLAB_HEADER ((sizeof(slab_t) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+/*
+slab_list_add - puts a slab at the head of a cache list
+input: list - the list, slab - the slab
+output: none
+effect: none
+*/
+static void slab_list_add(slab_t** list, slab_t* slab){
+	slab->prev = NULL;
+	slab->next = *list;
+	if(*list != NULL)
+		(*list)->prev = slab;
+	*list = slab;
+}
+
+/*
+slab_list_del - takes a slab off a cache list
+input: list - the list, slab - the slab
+output: none
+effect: none
+*/
+static void slab_list_del(slab_t** list, slab_t* slab){
+	if(slab->prev != NULL)
+		slab->prev->next = slab->next;
+	else
+		*list = slab->next;
+	if(slab->next != NULL)
+		slab->next->prev = slab->prev;
+}
+
+/*
+kmem_cache_init - sets up an empty cache
+input: cache - the cache, name - for debugging, size - object size,
+		ctor - puts a new object in its constructed state, NULL for none
+output: 0 on success, -1 if the objects are too large for a slab
+effect: picks the smallest slab order that holds SLAB_MIN_OBJS objects, or as
+		many as the largest order holds. Takes no memory until the first alloc
+*/
+int32_t kmem_cache_init(kmem_cache_t* cache, const int8_t* name, uint32_t size, slab_ctor ctor){
+	uint32_t order;
+
+	cache->name = name;
+	cache->obj_size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+	cache->slot_size = (cache->obj_size + sizeof(void*) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+	for(order = 0; order < SLAB_MAX_ORDER; order++){
+		if(((FRAME_SIZE << order) - SLAB_HEADER) / cache->slot_size >= SLAB_MIN_OBJS)
+			break;
+	}
+	cache->order = order;
+	cache->per_slab = ((FRAME_SIZE << order) - SLAB_HEADER) / cache->slot_size;
+	cache->ctor = ctor;
+	cache->partial = NULL;
+	cache->full = NULL;
+	cache->empty = NULL;
+	cache->active = 0;
+	return (cache->per_slab != 0) ? 0 : -1;
+}
+
+/*
+slab_grow - carves a new slab for a cache
+input: cache - the cache
+output: the slab with every object free, NULL if the frame pool is out
+effect: runs the constructor on each object
+*/
+static slab_t* slab_grow(kmem_cache_t* cache){
+	slab_t* slab;
+	uint8_t* obj;
+	uint32_t i;
+
+	slab = (slab_t*)frame_alloc_order(cache->order);
+	if(slab == NULL)
+		return NULL;
+	slab->cache = cache;
+	slab->in_use = 0;
+	slab->free = NULL;
+	//thread the objects from the back, so the first one is handed out first
+	for(i = cache->per_slab; i > 0; i--){
+		obj = (uint8_t*)slab + SLAB_HEADER + (i - 1) * cache->slot_size;
+		if(cache->ctor != NULL)
+			cache->ctor(obj);
+		SLAB_LINK(cache, obj) = slab->free;
+		slab->free = obj;
+	}
+	return slab;
+}
+
+/*
+kmem_cache_alloc - takes an object from a cache
+input: cache - the cache
+output: the object in its constructed state, NULL if the frame pool is out
+effect: O(1) unless a new slab has to be carved
+*/
+void* kmem_cache_alloc(kmem_cache_t* cache){
+	uint32_t flags;
+	slab_t* slab;
+	void* obj;
+
+	cli_and_save(flags);
+	slab = cache->partial;
+	if(slab == NULL){
+		slab = cache->empty;
+		if(slab != NULL)
+			cache->empty = NULL;
+		else
+			slab = slab_grow(cache);
+		if(slab == NULL){
+			restore_flags(flags);
+			return NULL;
+		}
+		slab_list_add(&cache->partial, slab);
+	}
+	obj = slab->free;
+	slab->free = SLAB_LINK(cache, obj);
+	slab->in_use++;
+	if(slab->free == NULL){
+		slab_list_del(&cache->partial, slab);
+		slab_list_add(&cache->full, slab);
+	}
+	cache->active++;
+	restore_flags(flags);
+	return obj;
+}
+
+/*
+kmem_cache_free - gives an object back to its cache
+input: cache - the cache it came from, obj - the object
+output: none
+effect: a slab that empties is kept if the cache has no empty slab, otherwise
+		its frames go back to the pool. Ignores objects of other caches
+*/
+void kmem_cache_free(kmem_cache_t* cache, void* obj){
+	uint32_t flags;
+	slab_t* slab;
+
+	if(obj == NULL)
+		return;
+	slab = (slab_t*)((uint32_t)obj & ~((FRAME_SIZE << cache->order) - 1));
+	if(slab->cache != cache)
+		return;
+	cli_and_save(flags);
+	if(slab->free == NULL){
+		slab_list_del(&cache->full, slab);
+		slab_list_add(&cache->partial, slab);
+	}
+	SLAB_LINK(cache, obj) = slab->free;
+	slab->free = obj;
+	slab->in_use--;
+	cache->active--;
+	if(slab->in_use == 0){
+		slab_list_del(&cache->partial, slab);
+		if(cache->empty == NULL)
+			cache->empty = slab;
+		else
+			frame_free_order((uint32_t)slab, cache->order);
+	}
+	restore_flags(flags);
+}
@@ -0,0 +1,46 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "types.h"
+
+/*a slab is a block from the frame pool carved into equal objects; its header
+  sits at the start of the block, which is aligned to its size*/
+#define SLAB_MIN_OBJS 8			//grow the slab order until this many fit
+#define SLAB_MAX_ORDER 3		//32KB
+#define SLAB_ALIGN 8
+
+typedef void (*slab_ctor)(void* obj);
+
+struct kmem_cache_t;
+
+typedef struct slab_t{
+	struct slab_t* next;		//next slab on the same cache list
+	struct slab_t* prev;
+	struct kmem_cache_t* cache;
+	void* free;					//first free object, NULL when the slab is full
+	uint32_t in_use;			//objects handed out
+}slab_t;
+
+/*objects of one type. Freed objects keep their constructed state, so the
+  constructor only runs when a slab is first carved up*/
+typedef struct kmem_cache_t{
+	const int8_t* name;
+	uint32_t obj_size;
+	uint32_t slot_size;			//the object and the free list link after it
+	uint32_t order;				//frame pool order of a slab
+	uint32_t per_slab;
+	slab_ctor ctor;				//NULL for none
+	slab_t* partial;			//slabs with objects free, allocated from first
+	slab_t* full;
+	slab_t* empty;				//one slab with nothing allocated, kept for reuse
+	uint32_t active;			//objects handed out over all slabs
+}kmem_cache_t;
+
+/*sets up an empty cache; -1 if objects of this size do not fit a slab*/
+extern int32_t kmem_cache_init(kmem_cache_t* cache, const int8_t* name, uint32_t size, slab_ctor ctor);
+/*an object in its constructed state, NULL when the frame pool is out*/
+extern void* kmem_cache_alloc(kmem_cache_t* cache);
+/*gives an object back; it should be in its constructed state again*/
+extern void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+#endif
@@ -18,4 +18,10 @@ int32_t sigreturn (void);*/
 
 int32_t syscall_linkage(int32_t syscall_num);
 
+/*SYSENTER entry point, shares syscall_table with syscall_linkage*/
+void sysenter_entry(void);
+
+/*where a process made by fork starts, see sched_fork*/
+void fork_child_ret(void);
+
 #endif
@@ -5,6 +5,10 @@
 #include "filesys.h"
 #include "x86_desc.h"
 #include "syscalls_asm.h"
+#include "syscall_linker.h"
+#include "schedule.h"
+#include "clock.h"
+#include "frame.h"
 
 
 uint32_t pid; 					//should be initialized as 0, since this is C
@@ -12,8 +16,102 @@ uint8_t file_name[FILE_MAX];	//buffer for file name
 pcb* curr_pcb;					//the current pcb
 uint8_t args[ARG_MAX];			//buffer for arguments
 uint32_t arg_size;				//argument size
-uint8_t pid_free[PROCESS_MAX]; 			//1 indicates that pid is free
 
+/*free pids as a stack, so taking and giving one back are O(1); the pid a halt
+  gives back is the first one handed out again*/
+static uint32_t pid_stack[PROCESS_MAX];
+static uint32_t pid_top;
+
+/*kernel stack of each pid, 8KB from the frame pool. A pid keeps its stack once
+  it has one, since halt is still running on it when the pid is given back*/
+static uint32_t kernel_stacks[PROCESS_MAX];
+
+/*pcb of the process halt is returning from; halt has left its stack by the
+  time it frees it, so it cannot be kept in a local*/
+static pcb* halted_pcb;
+
+/*pcb of the last forked process to halt; it is still curr_pcb until the switch
+  away from it, so it is freed by the next one*/
+static pcb* exited_pcb;
+
+/*
+pid_init - marks every pid free
+input: none
+output: none
+effect: pid 0 is handed out first
+*/
+void pid_init(void)
+{
+	int i;
+	for(i = PROCESS_MAX - 1; i >= 0; i--)
+	{
+		pid_stack[pid_top++] = i;
+	}
+}
+
+/*
+put_free_pid - gives a pid back
+input: p - a pid from get_free_pid
+output: none
+effect: p is the next pid handed out
+*/
+void put_free_pid(uint32_t p)
+{
+	if(p < PROCESS_MAX && pid_top < PROCESS_MAX)
+		pid_stack[pid_top++] = p;
+}
+
+/*
+kernel_stack_alloc - makes sure a pid has a kernel stack
+input: p - the pid
+output: 0 on success, -1 if the frame pool is out of memory
+effect: the first exec on a pid takes its stack from the frame pool
+*/
+int32_t kernel_stack_alloc(uint32_t p)
+{
+	if(kernel_stacks[p] == 0)
+		kernel_stacks[p] = frame_alloc_order(KSTACK_ORDER);
+	return (kernel_stacks[p] != 0) ? 0 : -1;
+}
+
+/*
+kernel_stack_top - where a pid's kernel stack starts
+input: p - the pid
+output: the esp0 the pid runs its kernel side on
+effect: none
+*/
+uint32_t kernel_stack_top(uint32_t p)
+{
+	return kernel_stacks[p] + EIGHT_KB - FOUR;
+}
+
+
+/*
+sysenter_init - enables the SYSENTER/SYSEXIT system call path
+input: none
+output: none
+effect: points the SYSENTER MSRs at sysenter_entry. The stack MSR holds the address
+		of tss.esp0, which sysenter_entry loads, so it follows every process switch.
+		Does nothing on CPUs without SYSENTER; int 0x80 keeps working either way
+*/
+void sysenter_init(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+	asm volatile ("cpuid"
+				: "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+				: "a"(1));
+	if(!(edx & CPUID_SEP))
+		return;
+	asm volatile ("wrmsr"
+				:
+				: "c"(MSR_SYSENTER_CS), "a"(KERNEL_CS), "d"(0));
+	asm volatile ("wrmsr"
+				:
+				: "c"(MSR_SYSENTER_ESP), "a"(&tss.esp0), "d"(0));
+	asm volatile ("wrmsr"
+				:
+				: "c"(MSR_SYSENTER_EIP), "a"(sysenter_entry), "d"(0));
+}
 
 /*
 halt - halts the process
@@ -25,6 +123,9 @@ int32_t halt (uint8_t status)
 {
 	int i;
 	
+	//the run queue and curr_pcb must change together; iret turns interrupts back on
+	cli();
+
 	//pass 8-bit status to parent process (expanded to 32-bit)
 	pcb* parent_pcb = curr_pcb -> parent_pcb_ptr;
 	if(parent_pcb != NULL){
@@ -32,7 +133,7 @@ int32_t halt (uint8_t status)
 	}
 
 	/*free up the pid associated with the process*/
-	pid_free[curr_pcb->pid] = 1;
+	put_free_pid(curr_pcb->pid);
 	
 	//remove it from the linked list
 	//remove_pcb_from_list(curr_pcb->pid);
@@ -50,12 +151,27 @@ int32_t halt (uint8_t status)
 	}
 	
 	curr_pcb->pcb_in_use = 0;
+
+	/*drop the window's references on shared text frames*/
+	release_user_pages(curr_pcb->pid);
+	/*give back any real-time reservation*/
+	sched_rt_clear(curr_pcb);
+	timer_cancel(&curr_pcb->sleep_timer);
 	//while(1);
 
-	if(process_number == 1 || (term1_process == 1 && curr_terminal == 1) || (term2_process == 1 && curr_terminal == 2)) //is the first shell
+	if(curr_pcb->forked) //made by fork, nothing to return to
+	{
+		process_number--;
+		run_queue_remove(curr_pcb);
+		curr_pcb->state = PROC_SLEEPING;
+		pcb_free(exited_pcb);
+		exited_pcb = curr_pcb;
+		sched_exit();
+	}
+	else if(parent_pcb == NULL) //is the first shell of its terminal
 	{
 		process_number--;
-		//restart the shell, after which pid will be 1 again
+		//restart the shell in this process's place on the terminal
 		execute((uint8_t*)"shell"); 
 		while(1);
 	}
@@ -75,9 +191,13 @@ int32_t halt (uint8_t status)
 
 		restore_paging(curr_pcb->parent_pid);
 		tss.ss0 = KERNEL_DS;
-		tss.esp0 = KERNEL_START - (curr_pcb->parent_pid*EIGHT_KB)-FOUR;
+		tss.esp0 = kernel_stack_top(curr_pcb->parent_pid);
 		
+		//the parent takes the child's turn in the run queue again
+		run_queue_replace(curr_pcb, curr_pcb->parent_pcb_ptr);
+		halted_pcb = curr_pcb;
 		curr_pcb = curr_pcb->parent_pcb_ptr;
+		pcb_free(halted_pcb);
 	}
 
 	asm volatile ("movl %0, %%eax"
@@ -188,21 +308,14 @@ void parse (const uint8_t* command)
 /*
 Finds a pid that is free
 Inputs: none
-Outputs: return the pid that is free
-Side effect: changes pid array of that no. to 0 (in use)
+Outputs: return the pid that is free, -1 if all are in use
+Side effect: takes it off the free pid stack
 */
 int32_t get_free_pid()
 {
-	int i;
-	for(i=0; i<PROCESS_MAX; i++)
-	{
-		if(pid_free[i]==1)
-		{
-			pid_free[i]=0;
-			return i;
-		}
-	}
-	return -1;
+	if(pid_top == 0)
+		return -1;
+	return pid_stack[--pid_top];
 }
 
 /*
@@ -236,19 +349,13 @@ effect: saves registers, sets up paging, executes the file
 */
 int32_t execute (const uint8_t* command)
 {
-	int i;
+	uint32_t flags;
+	uint64_t start_ns = clock_now_ns();	//for the exec latency counters
 
-	/*increment process count*/
-	if(process_number >= 6)	
-		return -1;
+	/*execute uses shared buffers and swaps curr_pcb, so it must not be preempted;
+	  the iret into the new program turns interrupts back on*/
+	cli_and_save(flags);
 
-	if (process_number==0)
-	{
-		for(i=0; i<PROCESS_MAX; i++)
-		{
-			pid_free[i]=1;
-		}
-	}
 	//Note: remember to update curr_pcb!
 	uint32_t prev_cr3;
 
@@ -261,48 +368,49 @@ int32_t execute (const uint8_t* command)
 	
 	//printf("\nparse\n");
 	
-	/*Check file is an EXE*/
+	/*Check file is an EXE; repeated execs are served from the exec cache*/
 	int success;
-	uint8_t buf[4];
 	dentry_t dentry;
+	exec_cache_t* exe;
 	success = read_dentry_by_name(file_name, &dentry);
-	if(success==-1)
-		return success;
-	success = read_data(dentry.finode_type,0,buf,4);
-	if (success==-1)
+	if(success==-1){
+		restore_flags(flags);
 		return success;
-	
-	/*checks for exe magic numbers*/
-	if(!(buf[0]==0x7f && buf[1]==0x45 && buf[2]==0x4c && buf[3]==0x46))	
-		return -1;		
+	}
+	exe = exec_lookup(dentry.finode_type);
+	if (exe == NULL){
+		restore_flags(flags);
+		return -1;
+	}
 
 	pid = get_free_pid();
-	if (pid == -1)
+	if (pid == -1){
+		restore_flags(flags);
 		return pid;
-	/*set up new process' paging*/
-	new_process_init(pid);
-	process_number++;
-	if (curr_terminal == 1)
-	{
-		term1_process++;
 	}
-	if (curr_terminal == 2)
-	{
-		term2_process++;
+	/*set up new process' pcb, stack and paging*/
+	pcb* new_pcb = pcb_alloc();
+	if(new_pcb == NULL || kernel_stack_alloc(pid) == -1 || new_process_init(pid) == -1){
+		pcb_free(new_pcb);
+		put_free_pid(pid);
+		restore_flags(flags);
+		return -1;
 	}
+	process_number++;
 	//pid = process_number;	
 	
-	/*File loader*/
-	program_load(file_name, &dentry);
-	
-	//printf("program_load\n");
-	
 	/*setting up TSS for context switch*/
 	tss.ss0 = KERNEL_DS;
-	tss.esp0 = KERNEL_START - (pid*EIGHT_KB)-FOUR;
+	tss.esp0 = kernel_stack_top(pid);
 
 	pcb* parent_pcb = curr_pcb; 
-	curr_pcb = (pcb*) (KERNEL_START - (pid*EIGHT_KB)-FOUR - 2048);
+	pcb* prev_pcb = curr_pcb;
+	uint32_t terminal = (parent_pcb != NULL) ? parent_pcb->terminal : 0;
+	/*a shell started from a terminal's boot context, or restarted by halt,
+	  is the first process of its terminal and has no parent to return to*/
+	if(parent_pcb != NULL && (parent_pcb->pid >= PROCESS_MAX || parent_pcb->pcb_in_use == 0))
+		parent_pcb = NULL;
+	curr_pcb = new_pcb;
 	curr_pcb->pid = pid;
 	
 	asm volatile ("movl %%esp, %0"
@@ -317,7 +425,20 @@ int32_t execute (const uint8_t* command)
 	//Set up paging
 	init_pcb(parent_pcb, curr_pcb);
 	curr_pcb->cr3 = prev_cr3;
-	curr_pcb->parent_pid = parent_pcb->pid;
+	curr_pcb->parent_pid = (parent_pcb != NULL) ? parent_pcb->pid : pid;
+	curr_pcb->terminal = terminal;
+
+	/*the new process runs in its caller's place; the caller waits for it to halt*/
+	if(prev_pcb != NULL)
+		run_queue_replace(prev_pcb, curr_pcb);
+	else
+		run_queue_add(curr_pcb);
+	/*a shell restarted by halt replaces the pcb of the one that halted*/
+	if(prev_pcb != NULL && prev_pcb->pid < PROCESS_MAX && prev_pcb->pcb_in_use == 0)
+		pcb_free(prev_pcb);
+	
+	/*File loader: the window is not present, pages are loaded on first touch*/
+	program_load(exe);
 	
 //	add_pcb_to_list(curr_pcb);	//add it to linked list
 	
@@ -325,12 +446,10 @@ int32_t execute (const uint8_t* command)
 	copy_args();
 
 	extern uint32_t entry_point;
-	/*read byte 24-27 of the executable to obtain entry point*/
-	read_data(dentry.finode_type, 24, buf, 4);
-	
-	/*entry point is stored as little endian*/
-	entry_point = ((buf[3]<<24) | buf[2]<<16 | buf[1]<<8 | buf[0]);
+	/*entry point was read from bytes 24-27 when the executable was cached*/
+	entry_point = exe->entry_point;
 
+	exec_account((uint32_t)(clock_now_ns() - start_ns));
 	/*assembly linkage to set up user stack and switch*/
 	context_switch();
 
@@ -465,10 +584,227 @@ int32_t vidmap(uint8_t** screen_start)
       return -1;
     }
 	
-  *screen_start = (uint8_t *)_4kb_video_page(); //video memory
+  //video memory of the process's terminal, wherever it is right now
+  *screen_start = (uint8_t *)_4kb_video_page(curr_pcb->pid, curr_pcb->terminal, terminal_video_addr(curr_pcb->terminal));
+	return 0;
+}
+
+/*
+exec_stats - reports how well the exec cache is doing and how long execs take
+input: buf - where to store the hit and miss and latency counters
+output: -1 on fail, 0 on success
+effect: copies the exec counters to the user buffer
+*/
+int32_t exec_stats(exec_stats_t* buf)
+{
+	if(buf == NULL || (uint32_t)buf < USER_VMEM_START || (uint32_t)buf + sizeof(exec_stats_t) > USER_VMEM_END)
+		return -1;
+	exec_get_stats(buf);
 	return 0;
 }
 
+/*
+mmap - maps an open file read-only into the caller's address space
+input: fd - descriptor of an open regular file, start - where to store the address of the mapping
+output: -1 on fail, length of the file on success
+effect: the file's data blocks are mapped in place, so reading them costs no copy.
+		The mapping stays valid after the descriptor is closed, until the process halts
+*/
+int32_t mmap(int32_t fd, uint8_t** start)
+{
+	if(start == NULL || (uint32_t)start < USER_VMEM_START || (uint32_t)start + sizeof(uint8_t*) > USER_VMEM_END)
+		return -1;
+	if(fd < 2 || fd > 7 || curr_pcb->file_array[fd].file_in_use == 0)
+		return -1;
+	//only regular files have data blocks to map
+	if(curr_pcb->file_array[fd].f_ops != &file_fops)
+		return -1;
+	return file_mmap(curr_pcb->file_array[fd].inode_ptr, start);
+}
+
+/*
+getdents - batched directory read
+input: fd - descriptor of an open directory, buf - array of records, nbytes - size of buf
+output: -1 on fail, bytes filled in on success, 0 at the end of the directory
+effect: fills buf with one dirent_t per entry, as many as fit
+*/
+int32_t getdents(int32_t fd, dirent_t* buf, int32_t nbytes)
+{
+	if(buf == NULL || nbytes < 0 || (uint32_t)buf < USER_VMEM_START || (uint32_t)buf + nbytes > USER_VMEM_END)
+		return -1;
+	if(fd < 2 || fd > 7 || curr_pcb->file_array[fd].file_in_use == 0)
+		return -1;
+	if(curr_pcb->file_array[fd].f_ops != &directory_fops)
+		return -1;
+	return directory_getdents(fd, buf, nbytes);
+}
+
+/*
+lseek - moves the read position of an open file
+input: fd, offset in bytes, whence - SEEK_SET, SEEK_CUR or SEEK_END
+output: -1 on fail, the new position on success
+effect: only drivers with an f_seek operation support it
+*/
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence)
+{
+	if(fd < 0 || fd >= 8 || curr_pcb->file_array[fd].file_in_use == 0)
+		return -1;
+	return (curr_pcb->file_array[fd].f_ops)->f_seek(fd, offset, whence);
+}
+
+/*
+pread - reads from an open file at a given position
+input: fd, buf, nbytes, offset in bytes to start reading at
+output: -1 on fail, bytes read on success, 0 at end of file
+effect: unlike read, the file position is not moved
+*/
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset)
+{
+	if(buf == NULL || nbytes < 0 || fd < 0 || fd >= 8 || curr_pcb->file_array[fd].file_in_use == 0)
+		return -1;
+	return (curr_pcb->file_array[fd].f_ops)->f_pread(fd, buf, nbytes, offset);
+}
+
+/*
+fstat - describes an open file
+input: fd, buf - where to store the type, inode and length
+output: -1 on fail, 0 on success
+effect: fills in buf
+*/
+int32_t fstat(int32_t fd, stat_t* buf)
+{
+	if(buf == NULL || (uint32_t)buf < USER_VMEM_START || (uint32_t)buf + sizeof(stat_t) > USER_VMEM_END)
+		return -1;
+	if(fd < 0 || fd >= 8 || curr_pcb->file_array[fd].file_in_use == 0)
+		return -1;
+	return (curr_pcb->file_array[fd].f_ops)->f_stat(fd, buf);
+}
+
+/*
+rt_setparam - puts the process in the real-time class, paced by an open rtc
+input: fd - the rtc descriptor, budget_us - cpu time in microseconds it needs per
+		rtc interrupt, 0 to leave the class
+output: -1 on fail, 0 on success
+effect: the period is the descriptor's current tick interval. Each interrupt that
+		wakes the process from rtc_read refills its budget and sets its deadline one
+		period away; ready real-time processes run earliest deadline first, ahead of
+		every other process. Call again after changing the descriptor's frequency
+*/
+int32_t rt_setparam(int32_t fd, uint32_t budget_us)
+{
+	if(fd < 0 || fd >= 8 || curr_pcb->file_array[fd].file_in_use == 0)
+		return -1;
+	if(curr_pcb->file_array[fd].f_ops != &rtc_fops)
+		return -1;
+	return sched_rt_setparam(curr_pcb, curr_pcb->file_array[fd].rtc_div * 1000000 / RTC_MAX_FREQ, budget_us);
+}
+
+/*
+clock_gettime - reads a clock
+input: clk_id - CLOCK_MONOTONIC for time since boot, CLOCK_REALTIME for time since
+		1970, ts - where to store seconds and nanoseconds
+output: -1 on fail, 0 on success
+effect: fills in ts
+*/
+int32_t clock_gettime(uint32_t clk_id, timespec_t* ts)
+{
+	if(ts == NULL || (uint32_t)ts < USER_VMEM_START || (uint32_t)ts + sizeof(timespec_t) > USER_VMEM_END)
+		return -1;
+	return clock_read(clk_id, ts);
+}
+
+/*
+nanosleep - sleeps for a given time
+input: req - how long to sleep
+output: -1 on fail, 0 on success
+effect: the process waits on the timer wheel, off the run queue, until the first PIT
+		tick after the time is up
+*/
+int32_t nanosleep(const timespec_t* req)
+{
+	uint64_t duration;
+
+	if(req == NULL || (uint32_t)req < USER_VMEM_START || (uint32_t)req + sizeof(timespec_t) > USER_VMEM_END)
+		return -1;
+	if(req->tv_nsec >= NS_PER_SEC)
+		return -1;
+	duration = (uint64_t)req->tv_sec * NS_PER_SEC + req->tv_nsec;
+	if(duration != 0)
+		clock_sleep_until(clock_now_ns() + duration);
+	return 0;
+}
+
+/*
+sbrk - moves the program break
+input: increment - bytes to grow the heap by, negative to shrink it
+output: the old break, -1 on fail
+effect: growing only moves the break; new heap pages are mapped as zero pages when
+		first touched. Shrinking gives whole pages past the new break back to the pool
+*/
+int32_t sbrk(int32_t increment)
+{
+	uint32_t old_brk = curr_pcb->brk;
+	uint32_t new_brk;
+
+	if(increment > 0){
+		//exec refuses images that end past USER_HEAP_END, but never let the heap grow from there
+		if(old_brk > USER_HEAP_END || (uint32_t)increment > USER_HEAP_END - old_brk)
+			return -1;
+	}
+	else if(increment < 0 && 0 - (uint32_t)increment > old_brk - curr_pcb->brk_start){
+		return -1;
+	}
+	new_brk = old_brk + increment;
+	if(new_brk < old_brk)
+		unmap_user_pages(curr_pcb->pid, (new_brk + PAGE_SIZE_4KB - 1) & PAGE_ADDR_MASK,
+						 (old_brk + PAGE_SIZE_4KB - 1) & PAGE_ADDR_MASK);
+	curr_pcb->brk = new_brk;
+	return old_brk;
+}
+
+/*
+fork - makes a copy of the calling process
+input: none
+output: the child's pid in the parent, 0 in the child, -1 on fail
+effect: the child shares the parent's pages copy-on-write and runs alongside it on
+		the same terminal. It starts from a copy of the parent's system call frame,
+		so it returns from this call too; nothing waits for it to halt
+*/
+int32_t fork(void)
+{
+	uint32_t flags;
+	int32_t child_pid;
+	pcb* child;
+	uint32_t frame;
+
+	if(curr_pcb == NULL || curr_pcb->pid >= PROCESS_MAX)
+		return -1;
+	cli_and_save(flags);
+	child_pid = get_free_pid();
+	if(child_pid == -1){
+		restore_flags(flags);
+		return -1;
+	}
+	child = pcb_alloc();
+	if(child == NULL || kernel_stack_alloc(child_pid) == -1 || fork_user_pages(curr_pcb->pid, child_pid) == -1){
+		pcb_free(child);
+		put_free_pid(child_pid);
+		restore_flags(flags);
+		return -1;
+	}
+	pcb_fork(curr_pcb, child);
+	child->pid = child_pid;
+	child->parent_pid = curr_pcb->pid;
+	process_number++;
+
+	//int 0x80 and SYSENTER both leave the frame at the very top of the kernel stack
+	frame = kernel_stack_top(child_pid) - SYSCALL_FRAME_SIZE;
+	memcpy((void*)frame, (void*)(kernel_stack_top(curr_pcb->pid) - SYSCALL_FRAME_SIZE), SYSCALL_FRAME_SIZE);
+	sched_fork(child, (uint32_t*)frame);
+	restore_flags(flags);
+	return child_pid;
+}
+
 int32_t set_handler (int32_t signum, void* handler)
 {
 	return 0;
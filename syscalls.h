@@ -5,13 +5,22 @@
 #include "types.h"
 #include "x86_desc.h"
 #include "pcb.h"
+#include "filesys.h"
+#include "clock.h"
 
 #define FILE_MAX 32
 #define ARG_MAX 128
-#define KERNEL_START 0x800000
 #define EIGHT_KB 0x2000
+#define KSTACK_ORDER 1		//frame pool order of an 8KB kernel stack
+#define SYSCALL_FRAME_SIZE 44	//iret frame and the six registers a system call entry saves
 #define FOUR 0x4
-#define PROCESS_MAX 6
+#define PROCESS_MAX 32
+
+/*SYSENTER setup*/
+#define CPUID_SEP 0x800		//edx bit 11 of cpuid leaf 1
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
 
 pcb* curr_pcb;
 uint32_t entry_point;
@@ -22,7 +31,12 @@ void parse (const uint8_t* command);
 
 /*copies args into pcb args*/
 void copy_args();
+void pid_init(void);
 int32_t get_free_pid();
+void put_free_pid(uint32_t p);
+int32_t kernel_stack_alloc(uint32_t p);
+uint32_t kernel_stack_top(uint32_t p);
+void sysenter_init(void);
 
 int32_t halt (uint8_t status);
 int32_t execute (const uint8_t* command);
@@ -34,5 +48,16 @@ int32_t getargs (uint8_t* buf, int32_t nbytes);
 int32_t vidmap(uint8_t** screen_start);
 int32_t set_handler (int32_t signum, void* handler);
 int32_t sigreturn (void);
+int32_t exec_stats(exec_stats_t* buf);
+int32_t mmap(int32_t fd, uint8_t** start);
+int32_t getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence);
+int32_t pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+int32_t fstat(int32_t fd, stat_t* buf);
+int32_t rt_setparam(int32_t fd, uint32_t budget_us);
+int32_t clock_gettime(uint32_t clk_id, timespec_t* ts);
+int32_t nanosleep(const timespec_t* req);
+int32_t sbrk(int32_t increment);
+int32_t fork(void);
 
 #endif
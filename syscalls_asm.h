@@ -8,6 +8,8 @@
 
 /*keyboard wrapper for assembly linkage*/
 void context_switch(void);
+/*saves the running register set and resumes another*/
+void switch_context(uint32_t* prev_esp, uint32_t next_esp);
 
 #endif
 
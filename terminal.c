@@ -1,16 +1,14 @@
 #include "terminal.h"
 #include "paging.h"
+#include "syscalls.h"
 
-unsigned char terminal_buffer[TERMINAL_BUFF_SIZE];
-unsigned int newline_pressed;
-
-unsigned int index; //index for the buffer
 unsigned char prev_disp[DISP_HEIGHT*DISP_WIDTH]; //array of width * height
 unsigned char write_disp[DISP_HEIGHT*DISP_WIDTH]; //for term_write
 uint8_t char_buffer[7];
 
-terminal_t terminals[3]; //array of terminal structs
-static uint8_t video_buffer[3][VIDEO_BUFF_SIZE] __attribute__((aligned (0x4000)));
+terminal_t terminals[TERMINAL_MAX]; //array of terminal structs
+//video memory of the terminals that are not on screen
+static uint8_t video_buffer[TERMINAL_MAX][VIDEO_BUFF_SIZE] __attribute__((aligned (0x4000)));
 
 int terminal_x;
 int terminal_y;
@@ -28,6 +26,10 @@ void update_cursor(int x, int y)
 	set_x(terminal_x);
 	set_y(terminal_y);
 
+	//a terminal drawing in the background keeps its cursor to itself
+	if(run_terminal != curr_terminal)
+		return;
+
 	uint32_t position = x + y*DISP_WIDTH; //DISP_WIDTH = width
 	uint32_t pos_LOW = position & 0xFF; 
 	uint32_t pos_HIGH = (position>>8) & 0xFF; //shift byte, then mask
@@ -39,151 +41,117 @@ void update_cursor(int x, int y)
 	outb(pos_HIGH, 0x3D5);
 }
 
-//open up the terminal
-int32_t terminal_open(const uint8_t* filename)
+/*
+terminal_init - sets up the terminals before any process runs
+input: none
+output: none
+effect: terminal 0 is on screen, the others draw into blank buffers
+*/
+void terminal_init()
 {
-	int i = 0;
-	index = 0; //reset the buffer index
+	int t, i;
+	for(t = 0; t < TERMINAL_MAX; t++)
+	{
+		terminals[t].index = 0;
+		terminals[t].newline_pressed = 0;
+		terminals[t].x = 0;
+		terminals[t].y = 0;
+		wait_queue_init(&terminals[t].read_wq);
+		for(i = 0; i < TERMINAL_BUFF_SIZE; i++)
+		{
+			terminals[t].buffer[i] = NULL;
+		}
+		//blank screen: space characters, light grey on black
+		for(i = 0; i < VIDEO_BUFF_SIZE; i += 2)
+		{
+			video_buffer[t][i] = ' ';
+			video_buffer[t][i+1] = 0x7;
+		}
+	}
+	curr_terminal = 0;
+	run_terminal = 0;
+}
 
-	terminals[0].prev_process_id = '\0';
-	terminals[0].curr_process_id = 0;
-	terminals[0].process_count = 0;
+/*
+terminal_load - points video memory and the cursor at a terminal
+input: t - the terminal whose process is about to run
+output: none
+effect: saves the cursor of the terminal that was loaded, maps video memory to the
+		screen if t is on it or to t's buffer if not, and restores t's cursor
+*/
+void terminal_load(uint8_t t)
+{
+	terminals[run_terminal].x = terminal_x;
+	terminals[run_terminal].y = terminal_y;
+	run_terminal = t;
+	map_video_mem(terminal_video_addr(t));
+	update_cursor(terminals[t].x, terminals[t].y);
+}
 
-	term1_active = 0;
-	term2_active = 0;
-	term1_process = 0;
-	term2_process = 0;
-	curr_terminal = 0;
-	update_cursor(0,0);
-	//putc('>');
-	//update_cursor(1,0); //reset the cursor
+/*
+terminal_video_addr - where a terminal's video memory is
+input: t - the terminal
+output: the screen if t is on it, else t's buffer
+effect: none
+*/
+uint32_t terminal_video_addr(uint8_t t)
+{
+	return (t == curr_terminal) ? VIDEO : (uint32_t)video_buffer[t];
+}
+
+/*
+terminal_input - handles a keystroke for the terminal on screen
+input: keystroke - ascii of the key
+output: none
+effect: called from the keyboard interrupt, whichever terminal's process it interrupted
+*/
+void terminal_input(unsigned char keystroke)
+{
+	uint8_t prev_terminal = run_terminal;
+	terminal_load(curr_terminal);
+	keyboard_helper(keystroke);
+	terminal_load(prev_terminal);
+}
+
+//open up the terminal
+int32_t terminal_open(const uint8_t* filename)
+{
 	enable_irq(0x01); //PIC_1, keyboard controller
-	//initialize the buffer as empty
-	for (i = 0; i < TERMINAL_BUFF_SIZE; i++)
-	{
-		terminal_buffer[i] = NULL;
-	}
 	return 0;
 }
 
-//term_num is the terminal we will be switching to
+/*
+switch_terminals - puts another terminal on screen
+input: target_terminal - the terminal to show
+output: -1 if no switch is needed, 0 on success
+effect: the shown terminal's screen goes to its buffer and the target's buffer to the
+		screen. Every terminal's processes keep running; only where they draw changes
+*/
 int32_t switch_terminals(int32_t target_terminal)
 {
-	int i;
+	uint8_t prev_terminal;
+	uint32_t flags;
 
 	//check if no switch required
-	if(curr_terminal == target_terminal)
+	if(curr_terminal == target_terminal || target_terminal < 0 || target_terminal >= TERMINAL_MAX)
 		return -1;
 
-	//not sure if saving ebp is necessary, actually. but keeping for now
-	asm volatile("movl %%cr3, %0;"
-		:"=a"(terminals[curr_terminal].cr3));
-	asm volatile("movl %%ebp, %0;"
-		:"=a"(terminals[curr_terminal].ebp));
-	asm volatile("movl %%esp, %0;"
-		:"=a"(terminals[curr_terminal].esp));
-	
-
-	//save the buffer
-	memcpy(terminals[curr_terminal].buffer, terminal_buffer,TERMINAL_BUFF_SIZE);
-//	for(i = 0; i < TERMINAL_BUFF_SIZE; i++)
-//		terminals[curr_terminal].buffer[i] = terminal_buffer[i];
+	cli_and_save(flags);
+	prev_terminal = run_terminal;
 
-	//update current terminal's cursor position
-	terminals[curr_terminal].x = terminal_x;
-	terminals[curr_terminal].y = terminal_y;
+	//with the shown terminal loaded, video memory is the screen
+	terminal_load(curr_terminal);
+	memcpy(video_buffer[curr_terminal], (void*)VIDEO, VIDEO_BUFF_SIZE);
+	memcpy((void*)VIDEO, video_buffer[target_terminal], VIDEO_BUFF_SIZE);
+	remap_vidmem(curr_terminal, (uint32_t)video_buffer[curr_terminal]);
+	remap_vidmem(target_terminal, VIDEO);
 
-	//copy video memory to locations in mem we set aside for the terminals
-	//haven't defined locs yet, 4kb size
-	
-	unsigned char* video_pointer = (unsigned char*)0xB8000;
-	for (i = 0; i < VIDEO_BUFF_SIZE; i++)
-	{
-		video_buffer[curr_terminal][i] = video_pointer[i];
-		if ( video_pointer[i] == NULL)
-			break;
-	}
-	disable_vidmem(terminals[curr_terminal].curr_process_id, video_buffer[curr_terminal], curr_terminal);
-	
-	//actually conduct the switch
-	clear();
-	update_cursor(0, 0);
 	curr_terminal = target_terminal;
+	terminal_load(target_terminal);	//moves the hardware cursor
 
-	//terminals[target_terminal].prev_process_id = 
-
-	if(target_terminal == 1 && term1_active == 0)
-	{
-		//initialize all of terminal 1's process counters
-		terminals[1].prev_process_id = '\0';
-		terminals[1].curr_process_id = pid;
-		terminals[1].process_count = 0;
-		//clear the buffer
-		for(i=0; i < TERMINAL_BUFF_SIZE; i++)
-		{
-			terminal_buffer[i] = '\0';
-		}
-		term1_active = 1;
-		execute((uint8_t*)"shell");
-		return 0;
-	}
-	if(target_terminal == 2 && term2_active == 0)
-	{
-		//initialize all of terminal 2's process counters
-		terminals[2].prev_process_id = '\0';
-		terminals[2].curr_process_id = pid;
-		terminals[2].process_count = 0;
-		//clear the buffer
-		for(i=0; i < TERMINAL_BUFF_SIZE; i++)
-		{
-			terminal_buffer[i] = '\0';
-		}
-		term2_active = 1;
-		execute((uint8_t*)"shell");
-		return 0;
-	}
-
-	//copy from locations to video memory
-	//continue using target_terminal for my own sanity
-	for (i = 0; i < VIDEO_BUFF_SIZE; i++)
-	{
-		video_pointer[i] = video_buffer[curr_terminal][i];
-		if ( video_pointer[i] == NULL)
-			break;
-	}
-	enable_vidmem(terminals[curr_terminal].curr_process_id,curr_terminal);
-	
-	
-	//now grab cursor locations
-	update_cursor(terminals[target_terminal].x, terminals[target_terminal].y);
-
-	//get the new buffer
-	for(i = 0; i < TERMINAL_BUFF_SIZE; i++)
-	{
-		terminal_buffer[i] = terminals[target_terminal].buffer[i];
-	}
-
-	if ( (terminals[target_terminal].esp == 0) || (terminals[target_terminal].ebp == 0) )
-	{
-	execute((uint8_t *)"shell");
-		asm volatile("movl %%ebp, %0;"
-			:"=a"(terminals[curr_terminal].ebp));
-		asm volatile("movl %%esp, %0;"
-			:"=a"(terminals[curr_terminal].esp));
-	}
-	
-	//restore stack pointers
-
-	asm volatile("mov %0, %%esp"
-		:
-		:"b"(terminals[target_terminal].esp));
-	asm volatile("mov %0, %%ebp"
-		:
-		:"b"(terminals[target_terminal].ebp));
-	asm volatile("mov %0, %%cr3"
-		:
-		:"b"(terminals[target_terminal].cr3));
-
+	//the interrupted process draws wherever its terminal now lives
+	terminal_load(prev_terminal);
+	restore_flags(flags);
 	return 0;
 }
 
@@ -200,41 +168,37 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
 {
 	
 	uint8_t * buff = (uint8_t *)buf;
+	terminal_t* term;
 	
-	int flag = 0;
 	int i;
 	int32_t ret;
 	//if(fd == 1)
 	//{
 	//	return -1; //failure
 	//}
-	newline_pressed = 0;
+	//each process reads the keyboard of its own terminal
+	term = &terminals[curr_pcb != NULL ? curr_pcb->terminal : 0];
+	term->newline_pressed = 0;
 	//flush the buffer terminal
 	for (i = 0; i < TERMINAL_BUFF_SIZE; i++)
 	{
-		terminal_buffer[i] = NULL;
+		term->buffer[i] = NULL;
 	}
-	while(flag == 0) //loop indefinitely
+	//sleep until keyboard_helper sees enter
+	wait_event(term->read_wq, term->newline_pressed == 1);
+	for(i = 0; (i < nbytes) && (i < TERMINAL_BUFF_SIZE); i++)
 	{
-		
-		if(newline_pressed == 1) // wait until enter is pressed
-		{
-			for(i = 0; (i < nbytes) && (i < TERMINAL_BUFF_SIZE); i++)
-			{
 
-				buff[i] = terminal_buffer[i]; //read the buffer
-				if(terminal_buffer[i] == '\0') //end of buffer
-				{
-					buff[i+1]='\n';
-					ret = i; //size of buffer, bytes read
-					break;
-				}
-			}
-			newline_pressed = 0;
-			flag = 1; //we can exit the loop now
+		buff[i] = term->buffer[i]; //read the buffer
+		if(term->buffer[i] == '\0') //end of buffer
+		{
+			if(i + 1 < nbytes)
+				buff[i+1]='\n';
+			break;
 		}
-		
 	}
+	ret = i; //bytes read: up to the end of the line, or all that fit
+	term->newline_pressed = 0;
 	return ret;
 }
 
@@ -338,6 +302,7 @@ int32_t scroll_up(unsigned char* history)
 //takes in keyboard input, for backspace and CTRL+L functionality
 void keyboard_helper(unsigned char keystroke)
 {
+	terminal_t* term = &terminals[curr_terminal]; //keys go to the terminal on screen
 	//int i, j; //two counters
 	//int32_t str_eq;
 
@@ -357,12 +322,12 @@ void keyboard_helper(unsigned char keystroke)
 	*/
 	else if(keystroke == '\r') //backspace
 	{
-		if(index == 0 || (terminal_x == 0 && terminal_y == 0))
+		if(term->index == 0 || (terminal_x == 0 && terminal_y == 0))
 		{
 			return;
 		}
-		index--;
-		terminal_buffer[index] = NULL;
+		term->index--;
+		term->buffer[term->index] = NULL;
 		if(terminal_x == 0)
 		{
 			update_cursor(DISP_WIDTH - 1, terminal_y - 1);
@@ -381,34 +346,35 @@ void keyboard_helper(unsigned char keystroke)
 		putc('\n');
 		update_cursor(0, terminal_y+1);
 		//account for hanging character
-		if((keystroke != '\n') && (index < TERMINAL_BUFF_SIZE))
+		if((keystroke != '\n') && (term->index < TERMINAL_BUFF_SIZE))
 		{
-			terminal_buffer[index] = keystroke;
-			index++;
+			term->buffer[term->index] = keystroke;
+			term->index++;
 			putc(keystroke);
 			update_cursor(terminal_x+1, terminal_y);
 		}
 		//newline, where last point may not be end
 		if(keystroke == '\n')
 		{
-			//terminal_buffer[index] = keystroke; //insert the newline char
-			newline_pressed = 1;
-			index = 0; //reset the buffer index
+			//term->buffer[term->index] = keystroke; //insert the newline char
+			term->newline_pressed = 1;
+			wake_up(&term->read_wq); //terminal_read can return now
+			term->index = 0; //reset the buffer index
 			//update_cursor(0, terminal_y+1);
 			//putc('>');
 			update_cursor(terminal_x, terminal_y);
 		}
 	}
 	//anything else, just add to buffer
-	else if((index < TERMINAL_BUFF_SIZE) && (keystroke >= 32) && (keystroke <= 126)) // space to tilde
+	else if((term->index < TERMINAL_BUFF_SIZE) && (keystroke >= 32) && (keystroke <= 126)) // space to tilde
 	{
 		//band-aid fix for l or L showing up when pressing ctrl+L
 		if((keystroke == 'l' || keystroke == 'L') && ctrl_on != 0)
 		{
 			return;
 		}
-		terminal_buffer[index] = keystroke; //add to buffer
-		index++; //update the index
+		term->buffer[term->index] = keystroke; //add to buffer
+		term->index++; //update the index
 		putc(keystroke);
 		update_cursor(terminal_x+1, terminal_y);
 	}
@@ -7,11 +7,13 @@
 //#include "filesystem.h"
 #include "x86_desc.h"
 #include "pcb.h"
+#include "waitqueue.h"
 
 #define TERMINAL_BUFF_SIZE 1024
 #define VIDEO_BUFF_SIZE 4096
 #define DISP_HEIGHT 25
 #define DISP_WIDTH 80
+#define TERMINAL_MAX 3
 
 //term 0 is the starting one
 uint8_t term1_active;
@@ -20,11 +22,15 @@ uint8_t term2_active;
 uint8_t term1_process;
 uint8_t term2_process;
 
-uint8_t curr_terminal; //holds the current terminal number
+uint8_t curr_terminal; //holds the current terminal number, the one on screen
+uint8_t run_terminal; //terminal whose video memory and cursor are loaded
 
 typedef struct terminal_t
 {
-	unsigned char buffer[TERMINAL_BUFF_SIZE];
+	unsigned char buffer[TERMINAL_BUFF_SIZE]; //line being typed
+	uint32_t index; //index for the buffer
+	volatile uint32_t newline_pressed; //set when enter completes the line
+	wait_queue_t read_wq; //processes sleeping in terminal_read until enter is pressed
 	
 	int x; //cursorx
 	int y; //cursory
@@ -43,6 +49,11 @@ typedef struct terminal_t
 
 terminal_t* get_terminals();
 
+void terminal_init();
+void terminal_load(uint8_t t);
+uint32_t terminal_video_addr(uint8_t t);
+void terminal_input(unsigned char keystroke);
+
 int32_t switch_terminals(int32_t target_terminal);
 
 int32_t terminal_open(const uint8_t * filename);
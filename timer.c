@@ -0,0 +1,242 @@
+#include "timer.h"
+#include "lib.h"
+#include "clock.h"
+#include "schedule.h"
+
+volatile uint32_t timer_jiffies;
+
+/*next tick the wheel has not processed yet; slot k runs when timer_jiffies reaches k*/
+static uint32_t wheel_jiffies;
+static uint32_t timer_tick_ns;
+
+/*each slot is a circular list headed by a dummy entry, so insert and cancel
+  never have to look at the list*/
+static ktimer_t tv1[TVR_SIZE];
+static ktimer_t tvn[TVN_LEVELS][TVN_SIZE];
+
+/*
+slot_init - empties one slot
+input: head - the slot's dummy entry
+output: none
+effect: none
+*/
+static void slot_init(ktimer_t* head){
+	head->next = head;
+	head->prev = head;
+}
+
+/*
+timer_init - empties the wheel
+input: tick_ns - length of a PIT tick in nanoseconds
+output: none
+effect: called before the PIT starts
+*/
+void timer_init(uint32_t tick_ns){
+	uint32_t i, level;
+
+	for(i = 0; i < TVR_SIZE; i++)
+		slot_init(&tv1[i]);
+	for(level = 0; level < TVN_LEVELS; level++){
+		for(i = 0; i < TVN_SIZE; i++)
+			slot_init(&tvn[level][i]);
+	}
+	timer_tick_ns = tick_ns;
+	wheel_jiffies = timer_jiffies + 1;	//the first tick processes the slot after now
+}
+
+/*
+timer_setup - prepares a timer
+input: timer, fn - what to call when it fires, data - passed to fn
+output: none
+effect: the timer is not pending
+*/
+void timer_setup(ktimer_t* timer, timer_fn fn, uint32_t data){
+	timer->next = NULL;
+	timer->prev = NULL;
+	timer->expires = 0;
+	timer->fn = fn;
+	timer->data = data;
+}
+
+/*
+timer_slot - the slot a timer belongs in
+input: expires - the tick it fires on
+output: the slot's dummy entry
+effect: none. Timers already due go in the slot processed next, timers past the
+		last wheel are held at its far end and cascade down from there
+*/
+static ktimer_t* timer_slot(uint32_t expires){
+	uint32_t delta = expires - wheel_jiffies;
+	uint32_t level, shift;
+
+	if((int32_t)delta < 0)
+		return &tv1[wheel_jiffies & TVR_MASK];
+	if(delta < TVR_SIZE)
+		return &tv1[expires & TVR_MASK];
+	if(delta > TIMER_MAX_DELAY)
+		expires = wheel_jiffies + TIMER_MAX_DELAY;
+	shift = TVR_BITS;
+	for(level = 0; level < TVN_LEVELS - 1; level++){
+		if(delta < (1U << (shift + TVN_BITS)))
+			break;
+		shift += TVN_BITS;
+	}
+	return &tvn[level][(expires >> shift) & TVN_MASK];
+}
+
+/*
+timer_enqueue - links a timer into its slot
+input: timer - a timer that is not pending
+output: none
+effect: called with interrupts off
+*/
+static void timer_enqueue(ktimer_t* timer){
+	ktimer_t* head = timer_slot(timer->expires);
+	timer->next = head;
+	timer->prev = head->prev;
+	head->prev->next = timer;
+	head->prev = timer;
+}
+
+/*
+timer_unlink - takes a pending timer out of its slot
+input: timer
+output: none
+effect: called with interrupts off
+*/
+static void timer_unlink(ktimer_t* timer){
+	timer->prev->next = timer->next;
+	timer->next->prev = timer->prev;
+	timer->next = NULL;
+	timer->prev = NULL;
+}
+
+/*
+timer_add - arms a timer
+input: timer, expires - tick to fire on, compared with timer_jiffies
+output: none
+effect: a timer that was already pending is moved to the new time. Tickless, the
+		wheel is caught up first and the one-shot moved earlier if the timer is
+		due before it
+*/
+void timer_add(ktimer_t* timer, uint32_t expires){
+	uint32_t flags;
+
+	cli_and_save(flags);
+	sched_nohz_sync();
+	if(timer->next != NULL)
+		timer_unlink(timer);
+	timer->expires = expires;
+	timer_enqueue(timer);
+	sched_nohz_rearm(expires);
+	restore_flags(flags);
+}
+
+/*
+timer_cancel - disarms a timer
+input: timer
+output: 1 if it was pending, 0 if it had fired or was never armed
+effect: fn will not be called
+*/
+int32_t timer_cancel(ktimer_t* timer){
+	uint32_t flags;
+	int32_t pending = 0;
+
+	cli_and_save(flags);
+	if(timer->next != NULL){
+		timer_unlink(timer);
+		pending = 1;
+	}
+	restore_flags(flags);
+	return pending;
+}
+
+/*
+timer_ns_to_ticks - converts a delay to ticks
+input: ns - the delay
+output: ticks that cover at least ns, between 1 and TIMER_MAX_DELAY
+effect: none
+*/
+uint32_t timer_ns_to_ticks(uint64_t ns){
+	uint32_t rem;
+
+	if(timer_tick_ns == 0)
+		return 1;
+	rem = div64_32(&ns, timer_tick_ns);
+	if(ns >= TIMER_MAX_DELAY)
+		return TIMER_MAX_DELAY;
+	return (uint32_t)ns + (rem != 0 || ns == 0);
+}
+
+/*
+cascade - moves one slot of a higher wheel down
+input: level - the wheel, index - the slot
+output: 1 if the next wheel up should cascade too
+effect: each timer is filed again relative to the current tick
+*/
+static int32_t cascade(uint32_t level, uint32_t index){
+	ktimer_t* head = &tvn[level][index];
+	ktimer_t* timer;
+
+	while(head->next != head){
+		timer = head->next;
+		timer_unlink(timer);
+		timer_enqueue(timer);
+	}
+	return index == 0;
+}
+
+/*
+timer_next_expiry - when the wheel next has work
+input: none
+output: the first tick with a timer in it, or the next cascade if that comes
+		first, since a cascade can bring a timer down. At most TVR_SIZE ticks ahead
+effect: none. Used to sleep through ticks that would have nothing to do
+*/
+uint32_t timer_next_expiry(){
+	uint32_t j = wheel_jiffies;
+	uint32_t i;
+	ktimer_t* head;
+
+	for(i = 0; i < TVR_SIZE; i++, j++){
+		if((j & TVR_MASK) == 0)
+			return j;
+		head = &tv1[j & TVR_MASK];
+		if(head->next != head)
+			return j;
+	}
+	return j;
+}
+
+/*
+timer_run - advances the wheel
+input: ticks - how many ticks have passed, 1 unless the PIT was tickless
+output: none
+effect: called from the PIT interrupt with interrupts off. Runs every timer due
+		by now; the work per tick does not depend on how many are pending
+*/
+void timer_run(uint32_t ticks){
+	uint32_t index, level, shift;
+	ktimer_t* head;
+	ktimer_t* timer;
+
+	timer_jiffies += ticks;
+	while((int32_t)(timer_jiffies - wheel_jiffies) >= 0){
+		index = wheel_jiffies & TVR_MASK;
+		if(index == 0){
+			shift = TVR_BITS;
+			for(level = 0; level < TVN_LEVELS; level++){
+				if(!cascade(level, (wheel_jiffies >> shift) & TVN_MASK))
+					break;
+				shift += TVN_BITS;
+			}
+		}
+		head = &tv1[index];
+		wheel_jiffies++;
+		while(head->next != head){
+			timer = head->next;
+			timer_unlink(timer);
+			timer->fn(timer->data);
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+
+/*hierarchical timer wheel counted in PIT ticks: a 256 slot wheel for the next
+  256 ticks, then three 64 slot wheels each covering 64 times the one below*/
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVN_LEVELS 3
+#define TIMER_MAX_DELAY ((1 << (TVR_BITS + TVN_LEVELS * TVN_BITS)) - 1)
+
+typedef void (*timer_fn)(uint32_t data);
+
+/*a pending call; lives inside whatever it times out (a pcb, a driver struct)*/
+typedef struct ktimer_t{
+	struct ktimer_t* next;	//next in the same slot, NULL when not pending
+	struct ktimer_t* prev;
+	uint32_t expires;		//tick to fire on
+	timer_fn fn;			//called from the PIT interrupt, interrupts off
+	uint32_t data;
+}ktimer_t;
+
+/*ticks since the wheel started*/
+extern volatile uint32_t timer_jiffies;
+
+/*empties the wheel; tick_ns is the length of one PIT tick*/
+extern void timer_init(uint32_t tick_ns);
+/*sets up a timer that is not pending*/
+extern void timer_setup(ktimer_t* timer, timer_fn fn, uint32_t data);
+/*makes the timer fire at tick expires, replacing any earlier arming*/
+extern void timer_add(ktimer_t* timer, uint32_t expires);
+/*stops a pending timer; 1 if it was pending*/
+extern int32_t timer_cancel(ktimer_t* timer);
+/*ticks from now that cover ns, at least 1*/
+extern uint32_t timer_ns_to_ticks(uint64_t ns);
+/*advances the wheel and runs what expired, from the PIT interrupt*/
+extern void timer_run(uint32_t ticks);
+/*tick of the next event on the wheel, or an earlier tick that may move one closer*/
+extern uint32_t timer_next_expiry();
+
+#endif
@@ -0,0 +1,313 @@
+/* fsbench.c - host microbenchmarks for filesys.c and lib.c
+ * vim:ts=4 noexpandtab
+ *
+ * Runs the kernel's read_data, read_dentry_by_name, memcpy, strncmp and itoa
+ * against a synthetic filesystem image held in a user-space buffer. Kernel
+ * symbols carry a k_ prefix (see the Makefile). Each benchmark reports the
+ * best cycles per call over several trials, and is compared against a
+ * stored baseline.
+ *
+ * Usage: fsbench [-b baseline] [-s] [-t percent] [-f]
+ *   -b  baseline file (default baseline.txt)
+ *   -s  save the results as the new baseline instead of comparing
+ *   -t  slowdown, in percent, reported as a regression (default 10)
+ *   -f  lay the image out fragmented, every other block out of order
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define BLOCK_SIZE		4096
+#define FNAME_MAX_CHAR	32
+#define DENTRY_MAX		63
+#define IMG_INODES		64
+#define IMG_BLOCKS		512
+#define TRIALS			7
+#define BENCH_MAX		32
+
+/*dentry layout, as in x86_desc.h*/
+typedef struct dentry_t{
+	uint8_t fname[FNAME_MAX_CHAR];
+	uint32_t ftype;
+	uint32_t finode_type;
+	uint32_t reserved[6];
+} dentry_t;
+
+/*kernel functions under test*/
+extern void k_bench_setup(void);
+extern void k_filesys_init(unsigned int addr);
+extern int32_t k_read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
+extern int32_t k_read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+extern void* k_memcpy(void* dest, const void* src, uint32_t n);
+extern int32_t k_strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
+extern int8_t* k_itoa(uint32_t value, int8_t* buf, int32_t radix);
+
+/*one synthetic file*/
+typedef struct bench_file_t{
+	const char* name;
+	uint32_t length;
+} bench_file_t;
+
+/*a text frame, a program image, a long name and one large file for throughput;
+  the rest of the directory is filled with small files*/
+static const bench_file_t bench_files[] = {
+	{ "frame0.txt", 187 },
+	{ "shell", 36 * 1024 + 100 },
+	{ "verylargetextwithverylongname.tx", 5277 },
+	{ "big.bin", 1024 * 1024 },
+};
+#define NAMED_FILES (sizeof(bench_files) / sizeof(bench_files[0]))
+#define FILLER_FILES 40
+
+/*kernel code keeps addresses in 32 bits, so everything lives in static buffers*/
+static uint8_t image[(1 + IMG_INODES + IMG_BLOCKS) * BLOCK_SIZE] __attribute__((aligned(BLOCK_SIZE)));
+static uint8_t dst[2 * 1024 * 1024 + 64] __attribute__((aligned(BLOCK_SIZE)));
+static char names[FILLER_FILES][FNAME_MAX_CHAR];
+
+/*a measured result*/
+typedef struct result_t{
+	char name[32];
+	double cycles;
+	uint32_t bytes;
+} result_t;
+
+static result_t results[BENCH_MAX];
+static int nresults;
+
+static inline uint64_t rdtsc(void)
+{
+	uint32_t lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+build_image - lays out the synthetic image
+Input: fragmented - 1 to swap every pair of blocks in each file
+Output: none
+*/
+static void build_image(int fragmented)
+{
+	uint32_t* boot = (uint32_t*)image;
+	dentry_t* dentries = (dentry_t*)image + 1;
+	uint32_t i, k, nfiles, blk, nblk, len;
+	uint32_t* inode;
+
+	memset(image, 0, sizeof(image));
+	nfiles = NAMED_FILES + FILLER_FILES;
+	blk = 0;
+	for(i = 0; i < nfiles; i++){
+		if(i < NAMED_FILES){
+			strncpy((char*)dentries[i].fname, bench_files[i].name, FNAME_MAX_CHAR);
+			len = bench_files[i].length;
+		}
+		else{
+			snprintf(names[i - NAMED_FILES], FNAME_MAX_CHAR, "filler%02u.txt", (unsigned)(i - NAMED_FILES));
+			strncpy((char*)dentries[i].fname, names[i - NAMED_FILES], FNAME_MAX_CHAR);
+			len = 100 + i * 37;
+		}
+		dentries[i].ftype = 2;
+		dentries[i].finode_type = i;
+
+		inode = (uint32_t*)(image + (1 + i) * BLOCK_SIZE);
+		inode[0] = len;
+		nblk = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		for(k = 0; k < nblk; k++){
+			/*swap neighbouring blocks so no run is longer than one block*/
+			if(fragmented && (k ^ 1) < nblk)
+				inode[k + 1] = blk + (k ^ 1);
+			else
+				inode[k + 1] = blk + k;
+		}
+		for(k = 0; k < len; k++)
+			image[(1 + IMG_INODES + inode[k / BLOCK_SIZE + 1]) * BLOCK_SIZE + k % BLOCK_SIZE] = (uint8_t)(k * 7 + i);
+		blk += nblk;
+	}
+	if(blk > IMG_BLOCKS){
+		fprintf(stderr, "fsbench: image needs %u blocks\n", blk);
+		exit(2);
+	}
+	boot[0] = nfiles;
+	boot[1] = IMG_INODES;
+	boot[2] = IMG_BLOCKS;
+}
+
+/*
+record - stores a result
+Input: name, best cycles per call, bytes moved per call (0 if none)
+Output: none
+*/
+static void record(const char* name, double cycles, uint32_t bytes)
+{
+	strncpy(results[nresults].name, name, sizeof(results[nresults].name) - 1);
+	results[nresults].cycles = cycles;
+	results[nresults].bytes = bytes;
+	nresults++;
+}
+
+/*times a statement: best of TRIALS runs of ITERS calls, in cycles per call*/
+#define BENCH(name, iters, bytes, stmt)						\
+do {														\
+	uint64_t best = ~0ULL, t0, t;							\
+	uint32_t it_;											\
+	int tr_;												\
+	for(tr_ = 0; tr_ < TRIALS; tr_++){						\
+		t0 = rdtsc();										\
+		for(it_ = 0; it_ < (iters); it_++){ stmt; }			\
+		t = rdtsc() - t0;									\
+		if(t < best)										\
+			best = t;										\
+	}														\
+	record(name, (double)best / (iters), bytes);			\
+} while(0)
+
+/*
+check_reads - makes sure read_data returns what build_image wrote
+Input: none
+Output: 0 if every file reads back correctly
+*/
+static int check_reads(void)
+{
+	uint32_t i, k;
+	for(i = 0; i < NAMED_FILES; i++){
+		if(k_read_data(i, 0, dst, bench_files[i].length) != (int32_t)bench_files[i].length)
+			return -1;
+		for(k = 0; k < bench_files[i].length; k++){
+			if(dst[k] != (uint8_t)(k * 7 + i))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+static void run_benchmarks(void)
+{
+	dentry_t dentry;
+	int8_t itoa_buf[16];
+	static const char s1[] = "verylargetextwithverylongname.tx";
+	static char s2[sizeof(s1)];
+	volatile int32_t sink = 0;
+	uint32_t n = 0;
+
+	memcpy(s2, s1, sizeof(s1));
+
+	/*directory lookups*/
+	BENCH("dentry_hit", 10000, 0,
+		sink += k_read_dentry_by_name((const uint8_t*)bench_files[n++ % NAMED_FILES].name, &dentry));
+	BENCH("dentry_hit_last", 10000, 0,
+		sink += k_read_dentry_by_name((const uint8_t*)names[FILLER_FILES - 1], &dentry));
+	BENCH("dentry_miss", 10000, 0,
+		sink += k_read_dentry_by_name((const uint8_t*)"nosuchcommand", &dentry));
+
+	/*file reads: small, one block, unaligned across blocks, a program, a large file*/
+	BENCH("read_data_64", 10000, 64, sink += k_read_data(1, 100, dst, 64));
+	BENCH("read_data_4k", 10000, 4096, sink += k_read_data(1, 0, dst, 4096));
+	BENCH("read_data_6k_unaligned", 5000, 6000, sink += k_read_data(1, 3000, dst + 1, 6000));
+	BENCH("read_data_program", 1000, bench_files[1].length,
+		sink += k_read_data(1, 0, dst, bench_files[1].length));
+	BENCH("read_data_1m", 20, 1024 * 1024, sink += k_read_data(3, 0, dst, 1024 * 1024));
+
+	/*lib.c*/
+	BENCH("memcpy_4k", 10000, 4096, k_memcpy(dst, image, 4096));
+	BENCH("memcpy_4k_unaligned", 10000, 4096, k_memcpy(dst + 1, image + 3, 4096));
+	BENCH("memcpy_64k", 1000, 65536, k_memcpy(dst, image, 65536));
+	BENCH("strncmp_32", 100000, 0, sink += k_strncmp((const int8_t*)s1, (const int8_t*)s2, FNAME_MAX_CHAR));
+	BENCH("itoa_10", 100000, 0, k_itoa(0xDEADBEEF - n++, itoa_buf, 10));
+	BENCH("itoa_16", 100000, 0, k_itoa(0xDEADBEEF - n++, itoa_buf, 16));
+	(void)sink;
+}
+
+/*
+load_baseline - looks up a benchmark in the baseline file
+Input: open baseline file, benchmark name
+Output: baseline cycles, 0 if the benchmark is not in the file
+*/
+static double load_baseline(FILE* f, const char* name)
+{
+	char line[128], bname[64];
+	double cycles;
+
+	rewind(f);
+	while(fgets(line, sizeof(line), f) != NULL){
+		if(line[0] == '#')
+			continue;
+		if(sscanf(line, "%63s %lf", bname, &cycles) == 2 && strcmp(bname, name) == 0)
+			return cycles;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* baseline = "baseline.txt";
+	int save = 0, fragmented = 0, regressions = 0, i;
+	double threshold = 10.0, base, delta;
+	FILE* f;
+
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			baseline = argv[++i];
+		else if(strcmp(argv[i], "-s") == 0)
+			save = 1;
+		else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threshold = atof(argv[++i]);
+		else if(strcmp(argv[i], "-f") == 0)
+			fragmented = 1;
+		else{
+			fprintf(stderr, "usage: fsbench [-b baseline] [-s] [-t percent] [-f]\n");
+			return 2;
+		}
+	}
+
+	build_image(fragmented);
+	k_bench_setup();
+	k_filesys_init((unsigned int)(uintptr_t)image);
+	if(check_reads() != 0){
+		fprintf(stderr, "fsbench: read_data returned wrong data\n");
+		return 2;
+	}
+	run_benchmarks();
+
+	if(save){
+		f = fopen(baseline, "w");
+		if(f == NULL){
+			fprintf(stderr, "fsbench: cannot write %s\n", baseline);
+			return 2;
+		}
+		fprintf(f, "# fsbench baseline%s: name cycles-per-call\n", fragmented ? " (fragmented)" : "");
+		for(i = 0; i < nresults; i++)
+			fprintf(f, "%s %.1f\n", results[i].name, results[i].cycles);
+		fclose(f);
+		printf("saved %d results to %s\n", nresults, baseline);
+		return 0;
+	}
+
+	f = fopen(baseline, "r");
+	if(f == NULL)
+		printf("no baseline at %s, run with -s to record one\n", baseline);
+	printf("%-24s %12s %10s %12s %9s\n", "benchmark", "cycles/call", "bytes/cyc", "baseline", "change");
+	for(i = 0; i < nresults; i++){
+		printf("%-24s %12.1f ", results[i].name, results[i].cycles);
+		if(results[i].bytes)
+			printf("%10.2f ", results[i].bytes / results[i].cycles);
+		else
+			printf("%10s ", "-");
+		base = f != NULL ? load_baseline(f, results[i].name) : 0;
+		if(base > 0){
+			delta = (results[i].cycles - base) * 100.0 / base;
+			printf("%12.1f %+8.1f%%", base, delta);
+			if(delta > threshold){
+				printf("  REGRESSION");
+				regressions++;
+			}
+		}
+		printf("\n");
+	}
+	if(f != NULL)
+		fclose(f);
+	if(regressions)
+		printf("%d regression%s over %.0f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+	return regressions ? 1 : 0;
+}
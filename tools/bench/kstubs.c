@@ -0,0 +1,94 @@
+/* kstubs.c - stand-ins for the kernel code filesys.c and lib.c call into
+ * vim:ts=4 noexpandtab
+ *
+ * Built with the kernel's headers and flags, then prefixed with k_ along
+ * with filesys.o and lib.o, so it links against them and not against libc.
+ */
+
+#include "syscalls.h"
+#include "paging.h"
+#include "filesys.h"
+
+/*the process file_read and friends run on behalf of*/
+static pcb bench_pcb;
+
+/*
+bench_setup - points curr_pcb at the benchmark's process
+input: none
+output: none
+effect: file descriptors 2 and up are free for add_pcb_file
+*/
+void bench_setup(void)
+{
+	int i;
+	curr_pcb = &bench_pcb;
+	bench_pcb.pid = 0;
+	for(i = 0; i < 8; i++){
+		bench_pcb.file_array[i].file_in_use = (i < 2);
+		bench_pcb.file_array[i].no_file = 0;
+		bench_pcb.file_array[i].file_pos = 0;
+		bench_pcb.file_array[i].inode_ptr = 0;
+	}
+}
+
+/*
+add_pcb_file - minimal version of pcb.c's add_pcb_file
+input: cur_pcb, inode_ptr, type as in pcb.c
+output: the new descriptor, -1 if the array is full
+effect: marks the first free descriptor in use
+*/
+int32_t add_pcb_file(pcb* cur_pcb, uint32_t inode_ptr, int32_t type)
+{
+	uint32_t i;
+	for(i = 2; i < 8; i++){
+		if(cur_pcb->file_array[i].file_in_use == 0){
+			cur_pcb->file_array[i].inode_ptr = inode_ptr;
+			cur_pcb->file_array[i].file_pos = 0;
+			cur_pcb->file_array[i].file_in_use = 1;
+			cur_pcb->file_array[i].no_file = 1;
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+pcb_close_file - minimal version of pcb.c's pcb_close_file
+input: idx, cur_pcb
+output: 0 on success, -1 on failure
+effect: frees the descriptor
+*/
+int32_t pcb_close_file(uint32_t idx, pcb* cur_pcb)
+{
+	if(idx < 2 || idx > 7 || cur_pcb->file_array[idx].file_in_use == 0)
+		return -1;
+	cur_pcb->file_array[idx].file_in_use = 0;
+	cur_pcb->file_array[idx].no_file = 0;
+	return 0;
+}
+
+/*the demand paging path is not benchmarked on the host*/
+int32_t map_user_page(uint32_t process_num, uint32_t vaddr)
+{
+	return -1;
+}
+
+int32_t map_shared_page(uint32_t process_num, uint32_t vaddr, uint32_t inode, uint32_t page_idx)
+{
+	return -1;
+}
+
+uint32_t user_page_frame(uint32_t process_num, uint32_t vaddr)
+{
+	return 0;
+}
+
+int32_t mmap_reserve(uint32_t process_num, uint32_t npages)
+{
+	return -1;
+}
+
+int32_t map_file_page(uint32_t process_num, uint32_t vaddr, uint32_t paddr)
+{
+	return -1;
+}
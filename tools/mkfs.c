@@ -0,0 +1,426 @@
+/* mkfs.c - host-side tool that builds and defragments boot-block filesystem images
+ * vim:ts=4 noexpandtab
+ *
+ * Usage:
+ *   mkfs -o <image> <dir>        build an image from the regular files in <dir>
+ *   mkfs -d <image> -o <image>   rewrite an existing image with contiguous files
+ *   mkfs -c <image>              report fragmentation of an existing image,
+ *                                exits 1 if any file is fragmented
+ *
+ * Every file's data blocks are laid out contiguously and in order, so each
+ * inode is a single run for read_data's bulk copy in filesys.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/*layout constants, must match filesys.h*/
+#define BLOCK_SIZE			4096
+#define FNAME_MAX_CHAR		32
+#define DIR_ENTRY_SIZE		64
+#define DENTRY_MAX			63
+#define INODE_BLK_MAX		((BLOCK_SIZE / 4) - 1)
+#define INODE_MAX			64
+#define EXTENT_POOL_SIZE	1024
+
+/*dentry file types*/
+#define TYPE_RTC			0
+#define TYPE_DIR			1
+#define TYPE_FILE			2
+
+/*a directory entry as stored in the boot block*/
+typedef struct dentry_t{
+	uint8_t fname[FNAME_MAX_CHAR];
+	uint32_t ftype;
+	uint32_t inode;
+	uint8_t reserved[24];
+} dentry_t;
+
+/*the boot block*/
+typedef struct bootblock_t{
+	uint32_t dir_no;
+	uint32_t inode_no;
+	uint32_t datablk_no;
+	uint8_t reserved[52];
+	dentry_t dentries[DENTRY_MAX];
+} bootblock_t;
+
+/*one file to be written to the image*/
+typedef struct file_t{
+	char name[FNAME_MAX_CHAR + 1];
+	uint8_t* data;
+	uint32_t length;
+} file_t;
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: mkfs -o <image> <dir>\n"
+		"       mkfs -d <image> -o <image>\n"
+		"       mkfs -c <image>\n");
+	exit(2);
+}
+
+/*
+read_file - reads a whole file into memory
+Input: path, where to store the length
+Output: malloc'd contents, NULL on failure
+*/
+static uint8_t* read_file(const char* path, uint32_t* length)
+{
+	FILE* f;
+	long size;
+	uint8_t* data;
+
+	f = fopen(path, "rb");
+	if(f == NULL)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	data = malloc(size > 0 ? size : 1);
+	if(data == NULL || (size > 0 && fread(data, 1, size, f) != (size_t)size)){
+		free(data);
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+	*length = (uint32_t)size;
+	return data;
+}
+
+static int file_cmp(const void* a, const void* b)
+{
+	return strcmp(((const file_t*)a)->name, ((const file_t*)b)->name);
+}
+
+/*
+write_image - lays out an image with every file in one contiguous run
+Input: output path, files in inode order, number of files,
+	   dentries to write (inode numbers refer to the files array)
+Output: 0 on success, -1 on failure
+*/
+static int write_image(const char* path, file_t* files, uint32_t nfiles,
+					   dentry_t* dentries, uint32_t ndentries)
+{
+	bootblock_t boot;
+	uint32_t i, nblocks, blk, file_blks;
+	uint32_t* inode;
+	uint8_t* image;
+	size_t image_size;
+	FILE* f;
+
+	/*count the data blocks*/
+	nblocks = 0;
+	for(i = 0; i < nfiles; i++){
+		file_blks = (files[i].length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		if(file_blks > INODE_BLK_MAX){
+			fprintf(stderr, "mkfs: %s is too large (%u bytes)\n", files[i].name, files[i].length);
+			return -1;
+		}
+		nblocks += file_blks;
+	}
+
+	image_size = (size_t)(1 + nfiles + nblocks) * BLOCK_SIZE;
+	image = calloc(1, image_size);
+	if(image == NULL)
+		return -1;
+
+	memset(&boot, 0, sizeof(boot));
+	boot.dir_no = ndentries;
+	boot.inode_no = nfiles;
+	boot.datablk_no = nblocks;
+	memcpy(boot.dentries, dentries, ndentries * sizeof(dentry_t));
+	memcpy(image, &boot, sizeof(boot));
+
+	/*each file takes the next run of blocks*/
+	blk = 0;
+	for(i = 0; i < nfiles; i++){
+		uint32_t k;
+		inode = (uint32_t*)(image + (size_t)(1 + i) * BLOCK_SIZE);
+		inode[0] = files[i].length;
+		file_blks = (files[i].length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		for(k = 0; k < file_blks; k++)
+			inode[k + 1] = blk + k;
+		memcpy(image + (size_t)(1 + nfiles + blk) * BLOCK_SIZE, files[i].data, files[i].length);
+		blk += file_blks;
+	}
+
+	f = fopen(path, "wb");
+	if(f == NULL || fwrite(image, 1, image_size, f) != image_size){
+		fprintf(stderr, "mkfs: cannot write %s\n", path);
+		if(f != NULL)
+			fclose(f);
+		free(image);
+		return -1;
+	}
+	fclose(f);
+	free(image);
+	printf("%s: %u entries, %u inodes, %u data blocks\n", path, ndentries, nfiles, nblocks);
+	return 0;
+}
+
+/*
+build - builds an image from a directory
+Input: output path, source directory
+Output: 0 on success, -1 on failure
+Effect: adds the "." directory and "rtc" device entries, then one regular
+		file per file in the directory, sorted by name
+*/
+static int build(const char* out, const char* dir)
+{
+	DIR* d;
+	struct dirent* ent;
+	struct stat st;
+	char path[4096];
+	file_t files[DENTRY_MAX];
+	dentry_t dentries[DENTRY_MAX];
+	uint32_t nfiles, ndentries, i;
+
+	d = opendir(dir);
+	if(d == NULL){
+		fprintf(stderr, "mkfs: cannot open %s\n", dir);
+		return -1;
+	}
+
+	nfiles = 0;
+	while((ent = readdir(d)) != NULL){
+		if(ent->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		if(stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+			continue;
+		if(strlen(ent->d_name) > FNAME_MAX_CHAR){
+			fprintf(stderr, "mkfs: name too long, skipping %s\n", ent->d_name);
+			continue;
+		}
+		/*two entries are taken by "." and "rtc"*/
+		if(nfiles >= DENTRY_MAX - 2){
+			fprintf(stderr, "mkfs: directory full, skipping %s\n", ent->d_name);
+			continue;
+		}
+		strcpy(files[nfiles].name, ent->d_name);
+		files[nfiles].data = read_file(path, &files[nfiles].length);
+		if(files[nfiles].data == NULL){
+			fprintf(stderr, "mkfs: cannot read %s\n", path);
+			closedir(d);
+			return -1;
+		}
+		nfiles++;
+	}
+	closedir(d);
+	qsort(files, nfiles, sizeof(file_t), file_cmp);
+
+	memset(dentries, 0, sizeof(dentries));
+	strcpy((char*)dentries[0].fname, ".");
+	dentries[0].ftype = TYPE_DIR;
+	strcpy((char*)dentries[1].fname, "rtc");
+	dentries[1].ftype = TYPE_RTC;
+	ndentries = 2;
+	for(i = 0; i < nfiles; i++){
+		/*a 32 character name fills the field with no terminator*/
+		memcpy(dentries[ndentries].fname, files[i].name, strlen(files[i].name));
+		dentries[ndentries].ftype = TYPE_FILE;
+		dentries[ndentries].inode = i;
+		ndentries++;
+	}
+
+	i = write_image(out, files, nfiles, dentries, ndentries);
+	while(nfiles > 0)
+		free(files[--nfiles].data);
+	return i;
+}
+
+/*
+load_image - reads an image and checks its header
+Input: path, where to store the size
+Output: malloc'd image, NULL on failure
+*/
+static uint8_t* load_image(const char* path, uint32_t* size)
+{
+	uint8_t* image;
+	bootblock_t* boot;
+
+	image = read_file(path, size);
+	if(image == NULL){
+		fprintf(stderr, "mkfs: cannot read %s\n", path);
+		return NULL;
+	}
+	boot = (bootblock_t*)image;
+	if(*size < BLOCK_SIZE || boot->dir_no > DENTRY_MAX ||
+	   (uint64_t)(1 + boot->inode_no + boot->datablk_no) * BLOCK_SIZE > *size){
+		fprintf(stderr, "mkfs: %s is not a filesystem image\n", path);
+		free(image);
+		return NULL;
+	}
+	return image;
+}
+
+/*
+count_runs - counts the contiguous runs of data blocks in an inode
+Input: image, inode number
+Output: number of runs, 0 for an empty file
+*/
+static uint32_t count_runs(uint8_t* image, uint32_t inode)
+{
+	uint32_t* ino;
+	uint32_t k, nblk, runs;
+
+	ino = (uint32_t*)(image + (size_t)(1 + inode) * BLOCK_SIZE);
+	nblk = (ino[0] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if(nblk > INODE_BLK_MAX)
+		nblk = INODE_BLK_MAX;
+	runs = nblk > 0 ? 1 : 0;
+	for(k = 1; k < nblk; k++){
+		if(ino[k + 1] != ino[k] + 1)
+			runs++;
+	}
+	return runs;
+}
+
+/*
+check - reports how fragmented an image is
+Input: image path
+Output: 0 if every file is contiguous, 1 if some are not, -1 on failure
+*/
+static int check(const char* path)
+{
+	uint8_t* image;
+	bootblock_t* boot;
+	uint32_t size, i, runs, total_runs, fragmented, files;
+
+	image = load_image(path, &size);
+	if(image == NULL)
+		return -1;
+	boot = (bootblock_t*)image;
+
+	total_runs = 0;
+	fragmented = 0;
+	files = 0;
+	for(i = 0; i < boot->dir_no; i++){
+		dentry_t* d = &boot->dentries[i];
+		char name[FNAME_MAX_CHAR + 1];
+		if(d->ftype != TYPE_FILE || d->inode >= boot->inode_no)
+			continue;
+		memcpy(name, d->fname, FNAME_MAX_CHAR);
+		name[FNAME_MAX_CHAR] = '\0';
+		runs = count_runs(image, d->inode);
+		printf("%-32s inode %2u  %8u bytes  %3u run%s\n", name, d->inode,
+			   *(uint32_t*)(image + (size_t)(1 + d->inode) * BLOCK_SIZE), runs, runs == 1 ? "" : "s");
+		files++;
+		total_runs += runs;
+		if(runs > 1)
+			fragmented++;
+	}
+
+	printf("%u files, %u fragmented, %u runs in total\n", files, fragmented, total_runs);
+	/*the kernel only caches runs for this many inodes and runs, see filesys.h*/
+	if(boot->inode_no > INODE_MAX)
+		printf("warning: %u inodes, only the first %u get cached runs\n", boot->inode_no, INODE_MAX);
+	if(total_runs > EXTENT_POOL_SIZE)
+		printf("warning: %u runs exceed the kernel's pool of %u\n", total_runs, EXTENT_POOL_SIZE);
+	free(image);
+	return fragmented > 0 ? 1 : 0;
+}
+
+/*
+defrag - rewrites an image so every file is contiguous
+Input: input and output image paths
+Output: 0 on success, -1 on failure
+Effect: keeps the dentries and inode numbers; blocks no inode uses are dropped
+*/
+static int defrag(const char* in, const char* out)
+{
+	uint8_t* image;
+	bootblock_t* boot;
+	file_t* files;
+	uint32_t size, i, k, nblk, blk, ret;
+	uint32_t* ino;
+	uint8_t* data_base;
+
+	image = load_image(in, &size);
+	if(image == NULL)
+		return -1;
+	boot = (bootblock_t*)image;
+	data_base = image + (size_t)(1 + boot->inode_no) * BLOCK_SIZE;
+
+	files = calloc(boot->inode_no ? boot->inode_no : 1, sizeof(file_t));
+	if(files == NULL){
+		free(image);
+		return -1;
+	}
+
+	/*gather each inode's contents in file order*/
+	ret = 0;
+	for(i = 0; i < boot->inode_no && ret == 0; i++){
+		ino = (uint32_t*)(image + (size_t)(1 + i) * BLOCK_SIZE);
+		files[i].length = ino[0];
+		snprintf(files[i].name, sizeof(files[i].name), "inode %u", i);
+		nblk = (ino[0] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		if(nblk > INODE_BLK_MAX){
+			fprintf(stderr, "mkfs: inode %u has a bad length\n", i);
+			ret = -1;
+			break;
+		}
+		files[i].data = malloc(nblk ? nblk * BLOCK_SIZE : 1);
+		if(files[i].data == NULL){
+			ret = -1;
+			break;
+		}
+		for(k = 0; k < nblk; k++){
+			blk = ino[k + 1];
+			if(blk >= boot->datablk_no){
+				fprintf(stderr, "mkfs: inode %u has a bad block number %u\n", i, blk);
+				ret = -1;
+				break;
+			}
+			memcpy(files[i].data + k * BLOCK_SIZE, data_base + (size_t)blk * BLOCK_SIZE, BLOCK_SIZE);
+		}
+	}
+
+	if(ret == 0)
+		ret = write_image(out, files, boot->inode_no, boot->dentries, boot->dir_no);
+
+	for(i = 0; i < boot->inode_no; i++)
+		free(files[i].data);
+	free(files);
+	free(image);
+	return ret;
+}
+
+int main(int argc, char** argv)
+{
+	const char* out = NULL;
+	const char* in = NULL;
+	const char* chk = NULL;
+	const char* dir = NULL;
+	int i;
+
+	for(i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			out = argv[++i];
+		else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			in = argv[++i];
+		else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			chk = argv[++i];
+		else if(argv[i][0] != '-' && dir == NULL)
+			dir = argv[i];
+		else
+			usage();
+	}
+
+	if(chk != NULL && out == NULL && in == NULL && dir == NULL){
+		i = check(chk);
+		return i < 0 ? 2 : i;
+	}
+	if(in != NULL && out != NULL && dir == NULL)
+		return defrag(in, out) == 0 ? 0 : 1;
+	if(dir != NULL && out != NULL && in == NULL)
+		return build(out, dir) == 0 ? 0 : 1;
+	usage();
+	return 2;
+}
@@ -0,0 +1,212 @@
+/* frametest.c - host test of the buddy frame allocator in frame.c
+ * vim:ts=4 noexpandtab
+ *
+ * Maps the frame pool's physical range 8MB-128MB at the same addresses in
+ * this process, since frame.c keeps its free lists inside the free frames,
+ * and seeds it from a synthetic multiboot memory map with a reserved hole,
+ * a boot module and an entry above 4GB. Then checks that:
+ *   - only the usable, unreserved frames are counted free;
+ *   - random mixed-order allocations are aligned, never overlap and never
+ *     touch the hole or the module;
+ *   - once everything is freed, every block merges back and the pool
+ *     yields as many 4MB blocks as the holes leave room for;
+ *   - a frame shared through frame_get is freed only by its last frame_put.
+ * Kernel symbols carry a k_ prefix (see the Makefile). Exits nonzero on a
+ * failure.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define POOL_START		0x800000	//FRAME_POOL_START
+#define POOL_LIMIT		0x8000000	//FRAME_POOL_LIMIT
+#define FRAME_SIZE		0x1000
+#define FRAME_COUNT		((POOL_LIMIT - POOL_START) / FRAME_SIZE)
+#define MAX_ORDER		10
+#define MB				0x100000
+
+/*the synthetic machine: usable ram to 100MB, a reserved hole over two frames
+  at 50MB and a module in one frame at 9MB*/
+#define RAM_END			(100 * MB)
+#define HOLE_START		(50 * MB + 100)
+#define HOLE_LEN		4900
+#define MOD_START		(9 * MB)
+#define MOD_END			(9 * MB + 10)
+#define FREE_EXPECTED	((RAM_END - POOL_START) / FRAME_SIZE - 2 - 1)
+#define BLOCKS_EXPECTED	((RAM_END - POOL_START) / (4 * MB) - 2)	//the 4MB blocks around 9MB and 50MB are broken
+
+#define ITERATIONS		200000
+#define LIVE_MAX		20000
+
+/*multiboot layout, as in multiboot.h*/
+#define MULTIBOOT_MODS	0x00000008
+#define MULTIBOOT_MMAP	0x00000040
+typedef struct multiboot_info{
+	uint32_t flags;
+	uint32_t mem_lower;
+	uint32_t mem_upper;
+	uint32_t boot_device;
+	uint32_t cmdline;
+	uint32_t mods_count;
+	uint32_t mods_addr;
+	uint32_t elf_sec[4];
+	uint32_t mmap_length;
+	uint32_t mmap_addr;
+} multiboot_info_t;
+typedef struct module{
+	uint32_t mod_start;
+	uint32_t mod_end;
+	uint32_t string;
+	uint32_t reserved;
+} module_t;
+typedef struct memory_map{
+	uint32_t size;
+	uint32_t base_addr_low;
+	uint32_t base_addr_high;
+	uint32_t length_low;
+	uint32_t length_high;
+	uint32_t type;
+} memory_map_t;
+
+/*kernel functions under test*/
+extern void k_frame_init(multiboot_info_t* mbi);
+extern uint32_t k_frame_alloc_order(uint32_t order);
+extern void k_frame_free_order(uint32_t addr, uint32_t order);
+extern uint32_t k_frame_alloc(void);
+extern void k_frame_get(uint32_t addr);
+extern void k_frame_put(uint32_t addr);
+extern uint32_t k_frame_refcount(uint32_t addr);
+extern uint32_t k_frame_free_count(void);
+
+/*frame.c stores these addresses in 32 bits, so they are static, not on the stack*/
+static memory_map_t mmap_entries[] = {
+	{ 20, 0, 0, 0xA0000, 0, 1 },
+	{ 20, MB, 0, RAM_END - MB, 0, 1 },
+	{ 20, HOLE_START, 0, HOLE_LEN, 0, 2 },
+	{ 20, 0, 1, 16 * MB, 0, 1 },			//above 4GB, out of the pool's reach
+};
+static module_t module = { MOD_START, MOD_END, 0, 0 };
+static multiboot_info_t mbi;
+
+/*which frames are handed out, to catch overlaps*/
+static uint8_t owned[FRAME_COUNT];
+static struct { uint32_t addr, order; } live[LIVE_MAX];
+
+/*fixed seed, so a failure can be reproduced*/
+static uint32_t rand_state = 1;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245u + 12345u;
+	return rand_state >> 8;
+}
+
+/*
+check_block - checks one block just handed out and marks its frames owned
+Input: addr, order - the block
+Output: number of problems found
+*/
+static uint32_t check_block(uint32_t addr, uint32_t order)
+{
+	uint32_t i, idx, bad = 0;
+	uint32_t size = FRAME_SIZE << order;
+
+	if((addr - POOL_START) & (size - 1))
+		bad++;
+	if(addr < POOL_START || addr + size > RAM_END)
+		bad++;
+	if(addr < MOD_END && addr + size > MOD_START)
+		bad++;
+	if(addr < HOLE_START + HOLE_LEN && addr + size > HOLE_START)
+		bad++;
+	idx = (addr - POOL_START) / FRAME_SIZE;
+	for(i = 0; i < (1u << order) && idx + i < FRAME_COUNT; i++){
+		if(owned[idx + i])
+			bad++;
+		owned[idx + i] = 1;
+	}
+	if(bad)
+		printf("block 0x%x order %u is misplaced or overlaps\n", addr, order);
+	return bad;
+}
+
+int main(void)
+{
+	uint32_t i, it, k, addr, order, n = 0, blocks, bad = 0;
+
+	if(mmap((void*)POOL_START, POOL_LIMIT - POOL_START, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void*)POOL_START){
+		perror("mapping the frame pool");
+		return 1;
+	}
+
+	mbi.flags = MULTIBOOT_MMAP | MULTIBOOT_MODS;
+	mbi.mmap_addr = (uint32_t)(uintptr_t)mmap_entries;
+	mbi.mmap_length = sizeof(mmap_entries);
+	mbi.mods_count = 1;
+	mbi.mods_addr = (uint32_t)(uintptr_t)&module;
+	k_frame_init(&mbi);
+	if(k_frame_free_count() != FREE_EXPECTED){
+		printf("init: %u frames free, expected %u\n", k_frame_free_count(), FREE_EXPECTED);
+		bad++;
+	}
+
+	for(it = 0; it < ITERATIONS; it++){
+		if(n > 0 && (next_rand() % 2 || n == LIVE_MAX)){
+			k = next_rand() % n;
+			addr = live[k].addr;
+			order = live[k].order;
+			for(i = 0; i < (1u << order); i++)
+				owned[(addr - POOL_START) / FRAME_SIZE + i] = 0;
+			k_frame_free_order(addr, order);
+			live[k] = live[--n];
+		}
+		else{
+			//mostly small blocks, with the odd one up to 4MB
+			order = (next_rand() % 4) ? next_rand() % 3 : next_rand() % (MAX_ORDER + 1);
+			addr = k_frame_alloc_order(order);
+			if(addr == 0)
+				continue;
+			bad += check_block(addr, order);
+			live[n].addr = addr;
+			live[n].order = order;
+			n++;
+		}
+	}
+	while(n > 0){
+		n--;
+		k_frame_free_order(live[n].addr, live[n].order);
+	}
+	if(k_frame_free_count() != FREE_EXPECTED){
+		printf("random: %u frames free after freeing everything, expected %u\n", k_frame_free_count(), FREE_EXPECTED);
+		bad++;
+	}
+
+	//everything merged back: the pool splits into whole 4MB blocks again
+	for(blocks = 0; (addr = k_frame_alloc_order(MAX_ORDER)) != 0; blocks++)
+		live[blocks].addr = addr;
+	if(blocks != BLOCKS_EXPECTED){
+		printf("merge: %u 4MB blocks, expected %u\n", blocks, BLOCKS_EXPECTED);
+		bad++;
+	}
+	for(i = 0; i < blocks; i++)
+		k_frame_free_order(live[i].addr, MAX_ORDER);
+
+	//a frame mapped twice, as after fork, goes back only with its last reference
+	addr = k_frame_alloc();
+	k_frame_get(addr);
+	k_frame_put(addr);
+	if(k_frame_refcount(addr) != 1 || k_frame_free_count() != FREE_EXPECTED - 1){
+		printf("refcount: frame freed while still referenced\n");
+		bad++;
+	}
+	k_frame_put(addr);
+	if(k_frame_free_count() != FREE_EXPECTED){
+		printf("refcount: frame not freed by its last reference\n");
+		bad++;
+	}
+
+	printf("frame: %u frames, %u 4MB blocks after merging, %u problems\n", FREE_EXPECTED, blocks, bad);
+	return bad != 0;
+}
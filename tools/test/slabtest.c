@@ -0,0 +1,169 @@
+/* slabtest.c - host test of the slab allocator in slab.c
+ * vim:ts=4 noexpandtab
+ *
+ * Runs slab.c on top of the real frame.c, with the frame pool mapped at its
+ * own addresses as in frametest. For a small and a pcb-sized object, random
+ * allocs and frees check that:
+ *   - an object is never handed out twice, and always comes back in the
+ *     state its constructor or its last user left it;
+ *   - the constructor only runs when a slab is carved;
+ *   - once everything is freed, all slabs but the one cached empty slab
+ *     go back to the frame pool.
+ * Kernel symbols carry a k_ prefix (see the Makefile). Exits nonzero on a
+ * failure.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define POOL_START		0x800000	//FRAME_POOL_START
+#define POOL_LIMIT		0x8000000	//FRAME_POOL_LIMIT
+#define SLAB_ALIGN		8
+
+#define ITERATIONS		300000
+#define LIVE_MAX		5000
+#define CONSTRUCTED		0x1234		//first word of an object that is free
+#define IN_USE			0x5678		//first word of an object that is handed out
+
+/*multiboot layout, as in multiboot.h; the pool is seeded from mem_upper*/
+#define MULTIBOOT_MEMINFO	0x00000001
+typedef struct multiboot_info{
+	uint32_t flags;
+	uint32_t mem_lower;
+	uint32_t mem_upper;
+	uint32_t boot_device;
+	uint32_t cmdline;
+	uint32_t mods_count;
+	uint32_t mods_addr;
+	uint32_t elf_sec[4];
+	uint32_t mmap_length;
+	uint32_t mmap_addr;
+} multiboot_info_t;
+
+/*cache layout, as in slab.h*/
+typedef void (*slab_ctor)(void* obj);
+typedef struct kmem_cache_t{
+	const char* name;
+	uint32_t obj_size;
+	uint32_t slot_size;
+	uint32_t order;
+	uint32_t per_slab;
+	slab_ctor ctor;
+	void* partial;
+	void* full;
+	void* empty;
+	uint32_t active;
+} kmem_cache_t;
+
+/*kernel functions under test*/
+extern void k_frame_init(multiboot_info_t* mbi);
+extern uint32_t k_frame_free_count(void);
+extern int32_t k_kmem_cache_init(kmem_cache_t* cache, const char* name, uint32_t size, slab_ctor ctor);
+extern void* k_kmem_cache_alloc(kmem_cache_t* cache);
+extern void k_kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+/*object sizes tried: a small one, and about a pcb*/
+static const uint32_t sizes[] = { 24, 612 };
+
+static multiboot_info_t mbi;
+static kmem_cache_t cache;
+static uint32_t* live[LIVE_MAX];
+static uint32_t ctor_calls;
+
+/*fixed seed, so a failure can be reproduced*/
+static uint32_t rand_state = 7;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245u + 12345u;
+	return rand_state >> 8;
+}
+
+/*the constructor under test: marks an object as constructed and free*/
+static void obj_ctor(void* obj)
+{
+	ctor_calls++;
+	*(uint32_t*)obj = CONSTRUCTED;
+}
+
+/*
+test_size - random allocs and frees from one cache
+Input: size - object size
+Output: number of problems found
+*/
+static uint32_t test_size(uint32_t size)
+{
+	uint32_t it, k, n = 0, bad = 0;
+	uint32_t frames = k_frame_free_count();
+	uint32_t* obj;
+
+	ctor_calls = 0;
+	if(k_kmem_cache_init(&cache, "test", size, obj_ctor) != 0){
+		printf("size %u: cache init failed\n", size);
+		return 1;
+	}
+	for(it = 0; it < ITERATIONS; it++){
+		if(n > 0 && (next_rand() % 2 || n == LIVE_MAX)){
+			k = next_rand() % n;
+			*live[k] = CONSTRUCTED;		//give it back in its constructed state
+			k_kmem_cache_free(&cache, live[k]);
+			live[k] = live[--n];
+		}
+		else{
+			obj = k_kmem_cache_alloc(&cache);
+			if(obj == NULL){
+				printf("size %u: out of memory with %u objects\n", size, n);
+				return bad + 1;
+			}
+			//IN_USE means it was handed out twice
+			if(*obj != CONSTRUCTED || ((uintptr_t)obj & (SLAB_ALIGN - 1)) ||
+				(uintptr_t)obj < POOL_START || (uintptr_t)obj >= POOL_LIMIT){
+				if(bad < 5)
+					printf("size %u: object %p handed out in a bad state\n", size, (void*)obj);
+				bad++;
+			}
+			*obj = IN_USE;
+			live[n++] = obj;
+		}
+	}
+	while(n > 0){
+		n--;
+		*live[n] = CONSTRUCTED;
+		k_kmem_cache_free(&cache, live[n]);
+	}
+
+	if(ctor_calls % cache.per_slab != 0){
+		printf("size %u: %u constructor calls, not whole slabs of %u\n", size, ctor_calls, cache.per_slab);
+		bad++;
+	}
+	if(cache.active != 0 || cache.partial != NULL || cache.full != NULL || cache.empty == NULL){
+		printf("size %u: cache not empty after freeing everything\n", size);
+		bad++;
+	}
+	if(k_frame_free_count() != frames - (1u << cache.order)){
+		printf("size %u: %u frames not returned\n", size, frames - k_frame_free_count());
+		bad++;
+	}
+	printf("slab: size %u, %u per slab of order %u, %u slabs carved, %u problems\n",
+		size, cache.per_slab, cache.order, ctor_calls / cache.per_slab, bad);
+	return bad;
+}
+
+int main(void)
+{
+	uint32_t i, bad = 0;
+
+	if(mmap((void*)POOL_START, POOL_LIMIT - POOL_START, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void*)POOL_START){
+		perror("mapping the frame pool");
+		return 1;
+	}
+	mbi.flags = MULTIBOOT_MEMINFO;
+	mbi.mem_upper = (POOL_LIMIT - 0x100000) / 1024;
+	k_frame_init(&mbi);
+
+	for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		bad += test_size(sizes[i]);
+	return bad != 0;
+}
@@ -0,0 +1,150 @@
+/* timertest.c - host test of the timer wheel in timer.c
+ * vim:ts=4 noexpandtab
+ *
+ * Arms thousands of timers at random delays and checks that each one fires
+ * on exactly the tick it was armed for:
+ *   - one tick at a time, with timer_jiffies wrapping past 2^32, every
+ *     seventh timer cancelled and delays reaching the top wheel;
+ *   - in the jumps a tickless kernel takes, each one no further than
+ *     timer_next_expiry.
+ * Kernel symbols carry a k_ prefix (see the Makefile). Exits nonzero on a
+ * failure.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define TICK_NS			10000000
+#define WRAP_TIMERS		5000
+#define WRAP_SHORT		300			//the first half stay on the first wheel
+#define WRAP_LONG		2000000		//the rest reach the top wheel
+#define NOHZ_TIMERS		3000
+#define NOHZ_SPAN		400000
+#define NOHZ_MAX_JUMP	5			//longest one-shot the PIT can be programmed for, in ticks
+
+/*timer layout, as in timer.h*/
+typedef void (*timer_fn)(uint32_t data);
+typedef struct ktimer_t{
+	struct ktimer_t* next;
+	struct ktimer_t* prev;
+	uint32_t expires;
+	timer_fn fn;
+	uint32_t data;
+} ktimer_t;
+
+/*kernel functions under test*/
+extern volatile uint32_t k_timer_jiffies;
+extern void k_timer_init(uint32_t tick_ns);
+extern void k_timer_setup(ktimer_t* timer, timer_fn fn, uint32_t data);
+extern void k_timer_add(ktimer_t* timer, uint32_t expires);
+extern int32_t k_timer_cancel(ktimer_t* timer);
+extern void k_timer_run(uint32_t ticks);
+extern uint32_t k_timer_next_expiry(void);
+
+static ktimer_t timers[WRAP_TIMERS];
+static uint32_t want[WRAP_TIMERS];
+static uint32_t fired[WRAP_TIMERS];
+
+/*fixed seed, so a failure can be reproduced*/
+static uint32_t rand_state;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245u + 12345u;
+	return rand_state >> 1;
+}
+
+/*timer callback: records the tick it ran on*/
+static void record(uint32_t idx)
+{
+	fired[idx] = k_timer_jiffies;
+}
+
+/*
+check_fired - compares each timer's firing tick with the one it was armed for
+Input: name - test name, n - timers armed
+Output: number of timers that fired on the wrong tick or not at all
+*/
+static uint32_t check_fired(const char* name, uint32_t n)
+{
+	uint32_t i, bad = 0;
+
+	for(i = 0; i < n; i++){
+		if(fired[i] != want[i]){
+			if(bad < 5)
+				printf("%s: timer %u armed for %u fired at %u\n", name, i, want[i], fired[i]);
+			bad++;
+		}
+	}
+	printf("%s: %u timers, %u wrong\n", name, n, bad);
+	return bad;
+}
+
+/*
+test_wrap - one tick at a time across the 2^32 wrap
+Input: none
+Output: number of failures
+*/
+static uint32_t test_wrap(void)
+{
+	uint32_t i;
+
+	rand_state = 1;
+	k_timer_jiffies = 0xFFFFF000u;
+	k_timer_init(TICK_NS);
+	for(i = 0; i < WRAP_TIMERS; i++){
+		k_timer_setup(&timers[i], record, i);
+		want[i] = k_timer_jiffies + 1 + next_rand() % (i < WRAP_TIMERS / 2 ? WRAP_SHORT : WRAP_LONG);
+		fired[i] = 0;
+		k_timer_add(&timers[i], want[i]);
+	}
+	for(i = 0; i < WRAP_TIMERS; i += 7){
+		k_timer_cancel(&timers[i]);
+		want[i] = 0;
+	}
+	for(i = 0; i < WRAP_LONG + 100; i++)
+		k_timer_run(1);
+	return check_fired("wrap", WRAP_TIMERS);
+}
+
+/*
+test_nohz - advances the wheel in jumps up to the next expiry
+Input: none
+Output: number of failures
+*/
+static uint32_t test_nohz(void)
+{
+	uint32_t i, end, jump;
+
+	rand_state = 7;
+	k_timer_jiffies = 0xFFFF0000u;
+	k_timer_init(TICK_NS);
+	for(i = 0; i < NOHZ_TIMERS; i++){
+		k_timer_setup(&timers[i], record, i);
+		want[i] = k_timer_jiffies + 1 + next_rand() % NOHZ_SPAN;
+		fired[i] = 0;
+		k_timer_add(&timers[i], want[i]);
+	}
+	end = k_timer_jiffies + NOHZ_SPAN + 100;
+	while((int32_t)(end - k_timer_jiffies) > 0){
+		jump = k_timer_next_expiry() - k_timer_jiffies;
+		//the wheel never asks to sleep past the first wheel, and never for 0 ticks
+		if(jump == 0 || jump > 257){
+			printf("nohz: next expiry %u ticks away at %u\n", jump, k_timer_jiffies);
+			return 1;
+		}
+		if(jump > NOHZ_MAX_JUMP)
+			jump = NOHZ_MAX_JUMP;
+		k_timer_run(jump);
+	}
+	return check_fired("nohz", NOHZ_TIMERS);
+}
+
+int main(void)
+{
+	uint32_t bad = 0;
+
+	bad += test_wrap();
+	bad += test_nohz();
+	return bad != 0;
+}
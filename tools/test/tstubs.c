@@ -0,0 +1,62 @@
+/* tstubs.c - stand-ins for the kernel code the tested files call into
+ * vim:ts=4 noexpandtab
+ *
+ * Built with the kernel's headers and flags, then prefixed with k_ along
+ * with the kernel objects under test, so they link against these and not
+ * against libc or the rest of the kernel.
+ */
+
+#include "clock.h"
+#include "schedule.h"
+
+/*
+div64_32 - clock.c's 64 by 32 bit division, in plain C
+input: n - the dividend, replaced by the quotient, base - the divisor
+output: the remainder
+effect: none
+*/
+uint32_t div64_32(uint64_t* n, uint32_t base)
+{
+	uint32_t rem = (uint32_t)(*n % base);
+	*n /= base;
+	return rem;
+}
+
+/*
+printf - lib.c's printf writes to video memory, which the host does not have
+input: format - ignored
+output: 0
+effect: none
+*/
+int32_t printf(int8_t *format, ...)
+{
+	return 0;
+}
+
+/*
+memset - lib.c's memset, in plain C
+input: s - the buffer, c - the byte, n - its length
+output: s
+effect: none
+*/
+void* memset(void* s, int32_t c, uint32_t n)
+{
+	uint8_t* p = s;
+	while(n-- > 0)
+		*p++ = (uint8_t)c;
+	return s;
+}
+
+/*
+sched_nohz_sync, sched_nohz_rearm - schedule.c's tickless hooks in timer_add
+input: as in schedule.c
+output: none
+effect: none; the tests move timer_jiffies themselves through timer_run
+*/
+void sched_nohz_sync()
+{
+}
+
+void sched_nohz_rearm(uint32_t expires)
+{
+}
@@ -0,0 +1,85 @@
+/* execbench.c - times the kernel side of execute
+ * vim:ts=4 noexpandtab
+ *
+ * Runs the program named in its arguments RUNS times and prints the average
+ * and worst time execute took to set it up, from the exec_stats counters.
+ * Pick a program that halts on its own without waiting for input.
+ */
+
+#include <stdint.h>
+
+#define SYS_EXECUTE		2
+#define SYS_WRITE		4
+#define SYS_GETARGS		7
+#define SYS_EXEC_STATS	11
+
+#define RUNS		100
+#define ARG_MAX		128
+
+/*must match exec_stats_t in the kernel's filesys.h*/
+typedef struct exec_stats_t{
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t execs;
+	uint32_t exec_ns_max;
+	uint64_t exec_ns_total;
+} exec_stats_t;
+
+extern int32_t int_syscall(int32_t num, int32_t a, int32_t b, int32_t c);
+
+static void puts_(const char* s)
+{
+	int32_t n = 0;
+	while(s[n] != '\0')
+		n++;
+	int_syscall(SYS_WRITE, 1, (int32_t)s, n);
+}
+
+static void putu(uint32_t v)
+{
+	char buf[11];
+	int i = 10;
+	buf[i] = '\0';
+	do{
+		buf[--i] = '0' + v % 10;
+		v /= 10;
+	} while(v != 0);
+	puts_(&buf[i]);
+}
+
+int main(void)
+{
+	static char cmd[ARG_MAX];
+	/*static, so counters an older kernel does not fill read as 0*/
+	static exec_stats_t before, after;
+	uint32_t runs, i;
+
+	if(int_syscall(SYS_GETARGS, (int32_t)cmd, ARG_MAX, 0) != 0 || cmd[0] == '\0'){
+		puts_("usage: execbench <program>\n");
+		return 1;
+	}
+
+	int_syscall(SYS_EXEC_STATS, (int32_t)&before, 0, 0);
+	for(i = 0; i < RUNS; i++){
+		if(int_syscall(SYS_EXECUTE, (int32_t)cmd, 0, 0) == -1){
+			puts_("execute failed\n");
+			return 1;
+		}
+	}
+	int_syscall(SYS_EXEC_STATS, (int32_t)&after, 0, 0);
+
+	/*the max is over every exec since boot, not only these runs*/
+	runs = after.execs - before.execs;
+	if(runs == 0){
+		puts_("kernel does not count exec latency\n");
+		return 1;
+	}
+	puts_("execs: ");
+	putu(runs);
+	puts_("\navg: ");
+	putu((uint32_t)(after.exec_ns_total - before.exec_ns_total) / runs);
+	puts_(" ns\nmax: ");
+	putu(after.exec_ns_max);
+	puts_(" ns\n");
+	return 0;
+}
@@ -0,0 +1,90 @@
+/* sysbench.c - compares the int 0x80 and SYSENTER system call paths
+ * vim:ts=4 noexpandtab
+ *
+ * Times a cheap system call (getargs with no buffer, which fails right
+ * after dispatch) through each entry path and prints the best average
+ * cycles per call over several trials.
+ */
+
+#include <stdint.h>
+
+#define SYS_HALT	1
+#define SYS_WRITE	4
+#define SYS_GETARGS	7
+
+#define CALLS		10000
+#define TRIALS		5
+
+extern int32_t int_syscall(int32_t num, int32_t a, int32_t b, int32_t c);
+extern int32_t fast_syscall(int32_t num, int32_t a, int32_t b, int32_t c);
+
+typedef int32_t (*syscall_fn)(int32_t num, int32_t a, int32_t b, int32_t c);
+
+static inline uint32_t rdtsc_lo(void)
+{
+	uint32_t lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return lo;
+}
+
+static void puts_(syscall_fn call, const char* s)
+{
+	int32_t n = 0;
+	while(s[n] != '\0')
+		n++;
+	call(SYS_WRITE, 1, (int32_t)s, n);
+}
+
+static void putu(syscall_fn call, uint32_t v)
+{
+	char buf[11];
+	int i = 10;
+	buf[i] = '\0';
+	do{
+		buf[--i] = '0' + v % 10;
+		v /= 10;
+	} while(v != 0);
+	puts_(call, &buf[i]);
+}
+
+/*
+measure - times CALLS system calls through one entry path
+Input: call - the entry path
+Output: best cycles per call over TRIALS runs
+*/
+static uint32_t measure(syscall_fn call)
+{
+	uint32_t best = 0xFFFFFFFF, t0, t;
+	int32_t i, tr;
+
+	for(tr = 0; tr < TRIALS; tr++){
+		t0 = rdtsc_lo();
+		for(i = 0; i < CALLS; i++)
+			call(SYS_GETARGS, 0, 0, 0);
+		t = (rdtsc_lo() - t0) / CALLS;
+		if(t < best)
+			best = t;
+	}
+	return best;
+}
+
+int main(void)
+{
+	uint32_t slow, fast;
+
+	/*make sure both paths dispatch the same way before timing them*/
+	if(fast_syscall(SYS_GETARGS, 0, 0, 0) != int_syscall(SYS_GETARGS, 0, 0, 0)){
+		puts_(int_syscall, "sysenter path returned a different result\n");
+		return 1;
+	}
+
+	slow = measure(int_syscall);
+	fast = measure(fast_syscall);
+
+	puts_(fast_syscall, "int 0x80: ");
+	putu(fast_syscall, slow);
+	puts_(fast_syscall, " cycles/call\nsysenter: ");
+	putu(fast_syscall, fast);
+	puts_(fast_syscall, " cycles/call\n");
+	return 0;
+}
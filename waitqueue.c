@@ -0,0 +1,75 @@
+#include "waitqueue.h"
+#include "pcb.h"
+#include "syscalls.h"
+#include "schedule.h"
+
+/*
+wait_queue_init - empties a wait queue
+input: wq - the queue
+output: none
+effect: no process is waiting on wq
+*/
+void wait_queue_init(wait_queue_t* wq)
+{
+	wq->head = NULL;
+}
+
+/*
+wait_prepare - puts the current process on a wait queue
+input: wq - the queue to sleep on
+output: none
+effect: marks the process asleep; must be called with interrupts off
+*/
+void wait_prepare(wait_queue_t* wq)
+{
+	pcb* p;
+
+	if(curr_pcb == NULL)
+		return;		//no process yet, wait_block just idles
+	curr_pcb->state = PROC_SLEEPING;
+	for(p = wq->head; p != NULL; p = p->wait_next){
+		if(p == curr_pcb)
+			return;		//already queued
+	}
+	curr_pcb->wait_next = wq->head;
+	wq->head = curr_pcb;
+}
+
+/*
+wait_block - gives up the cpu until the current process is woken
+input: none
+output: none
+effect: called and returns with interrupts off. The process leaves the run queue
+		and other processes run until an interrupt handler calls wake_up. Before
+		the scheduler starts the cpu just idles in hlt
+*/
+void wait_block(void)
+{
+	do{
+		if(curr_pcb == NULL || schedule() == -1)
+			asm volatile ("sti; hlt; cli" : : : "memory");
+	} while(curr_pcb != NULL && curr_pcb->state == PROC_SLEEPING);
+}
+
+/*
+wake_up - wakes every process sleeping on a wait queue
+input: wq - the queue
+output: none
+effect: marks the processes runnable, puts them back on the run queue and empties wq;
+		safe from interrupt handlers
+*/
+void wake_up(wait_queue_t* wq)
+{
+	pcb* p;
+	pcb* next;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	for(p = wq->head; p != NULL; p = next){
+		next = p->wait_next;
+		p->wait_next = NULL;
+		sched_wakeup(p);
+	}
+	wq->head = NULL;
+	restore_flags(flags);
+}
@@ -0,0 +1,35 @@
+#ifndef _WAITQUEUE_H
+#define _WAITQUEUE_H
+
+#include "types.h"
+#include "lib.h"
+
+struct pcb;
+
+/*processes sleeping until an event, linked through pcb->wait_next*/
+typedef struct wait_queue_t{
+	struct pcb* head;
+}wait_queue_t;
+
+/*
+wait_event - sleeps the current process on wq until cond holds
+cond is checked with interrupts off, so a wake_up from an interrupt
+handler between the check and the sleep is never lost
+*/
+#define wait_event(wq, cond)				\
+do {										\
+	uint32_t wait_flags_;					\
+	cli_and_save(wait_flags_);				\
+	while(!(cond)){							\
+		wait_prepare(&(wq));				\
+		wait_block();						\
+	}										\
+	restore_flags(wait_flags_);				\
+} while(0)
+
+extern void wait_queue_init(wait_queue_t* wq);
+extern void wait_prepare(wait_queue_t* wq);
+extern void wait_block(void);
+extern void wake_up(wait_queue_t* wq);
+
+#endif